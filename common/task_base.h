@@ -20,6 +20,27 @@ TASK(fixed_task, 1, true, sizeof(fixed_task), {
 
 TASK(fixed_reply, 2, true, sizeof(fixed_reply), { int64_t a[1]; })
 
+// values addr + k for k in [token, length), answered in pieces with a
+// continuation header (see exec_with_continuation)
+TASK(chunk_task, 3, true, sizeof(chunk_task), {
+    pptr addr;
+    int64_t length;
+    int64_t token;
+})
+
+TASK(chunk_reply, 4, false, -1, {})
+
+// the keys first, first + stride, ... below last as key_values (key, key),
+// from the token-th on; answered in pieces like chunk_task
+TASK(range_task, 5, true, sizeof(range_task), {
+    int64_t first;
+    int64_t last;
+    int64_t stride;
+    int64_t token;
+})
+
+TASK(range_reply, 6, false, -1, {})
+
 // #define FIXED_TSK 1
 // typedef struct {
 //     pptr addr;
@@ -58,6 +58,71 @@ void exec_fixed_task(int lft, int rt) {
     }
 }
 
+void exec_chunk_task(int lft, int rt) {
+    init_block_with_type(chunk_task, chunk_reply);
+
+    init_task_reader(lft);
+    uint32_t tid = me();
+    int64_t buf[16];
+    for (int i = lft; i < rt; i ++) {
+        chunk_task* ct = (chunk_task*)get_task_cached(i);
+        int64_t first = PPTR_TO_I64(ct->addr) + ct->token;
+        // keep room for the headers of the tasks after this one
+        int64_t room = variable_reply_remaining(tid) -
+                       (rt - i) * (CONTINUATION_HEADER + sizeof(int64_t));
+        int64_t n = ct->length - ct->token;
+        if (n > room / (int64_t)sizeof(int64_t)) {
+            n = (room > 0) ? room / (int64_t)sizeof(int64_t) : 0;
+        }
+        int64_t state = (ct->token + n < ct->length) ? CONTINUATION_MORE
+                                                      : CONTINUATION_DONE;
+        mpint64_t out = (mpint64_t)push_continuation_reply_zero_copy(
+            tid, state, ct->token + n, n * sizeof(int64_t));
+        for (int64_t k = 0; k < n; k += 16) {
+            int64_t m = (n - k < 16) ? (n - k) : 16;
+            for (int64_t j = 0; j < m; j ++) {
+                buf[j] = first + k + j;
+            }
+            mram_write(buf, out + k, m * sizeof(int64_t));
+        }
+    }
+}
+
+void exec_range_task(int lft, int rt) {
+    init_block_with_type(range_task, range_reply);
+
+    init_task_reader(lft);
+    uint32_t tid = me();
+    int64_t buf[16];
+    const int64_t kv = 2 * sizeof(int64_t);
+    for (int i = lft; i < rt; i ++) {
+        range_task* rg = (range_task*)get_task_cached(i);
+        int64_t total = (rg->last > rg->first)
+                            ? (rg->last - rg->first + rg->stride - 1) / rg->stride
+                            : 0;
+        // keep room for the headers of the tasks after this one
+        int64_t room = variable_reply_remaining(tid) -
+                       (rt - i) * (CONTINUATION_HEADER + sizeof(int64_t));
+        int64_t n = total - rg->token;
+        if (n > room / kv) {
+            n = (room > 0) ? room / kv : 0;
+        }
+        int64_t state = (rg->token + n < total) ? CONTINUATION_MORE
+                                                 : CONTINUATION_DONE;
+        mpint64_t out = (mpint64_t)push_continuation_reply_zero_copy(
+            tid, state, rg->token + n, n * kv);
+        int64_t key = rg->first + rg->token * rg->stride;
+        for (int64_t k = 0; k < n; k += 8) {
+            int64_t m = (n - k < 8) ? (n - k) : 8;
+            for (int64_t j = 0; j < m; j ++, key += rg->stride) {
+                buf[2 * j] = key;
+                buf[2 * j + 1] = key;
+            }
+            mram_write(buf, out + 2 * k, m * kv);
+        }
+    }
+}
+
 void exec_varlen_task(int lft, int rt) {
     (void)lft;
     (void)rt;
@@ -70,6 +135,14 @@ void execute(int lft, int rt) {
             exec_fixed_task(lft, rt);
             break;
         }
+        case chunk_task_id: {
+            exec_chunk_task(lft, rt);
+            break;
+        }
+        case range_task_id: {
+            exec_range_task(lft, rt);
+            break;
+        }
         // case : {
         //     exec_varlen_task(lft, rt);
         //     break;
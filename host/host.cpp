@@ -30,6 +30,7 @@
 #include "oracle.hpp"
 #include "sort.hpp"
 #include "driver.hpp"
+#include "open_loop.hpp"
 #include "obsolete_test_cases.hpp"
 
 /**
@@ -5,6 +5,8 @@
 #include <argparse/argparse.hpp>
 #include "random_generator.hpp"
 #include "task_framework_host.hpp"
+#include "epoch_coroutine.hpp"
+#include "scan_merge.hpp"
 #include "task.hpp"
 #include "oracle.hpp"
 #include "sort.hpp"
@@ -88,6 +90,325 @@ inline void taskgen(bool exec) {
     });
 }
 
+// n random task addresses, drawn like taskgen's
+inline parlay::sequence<pptr> random_addrs(int n) {
+    rn_gen rn(137);
+    return parlay::tabulate(n, [&](size_t i) {
+        uint64_t rd = abs(rn.random(i));
+        return (pptr){.id = (uint32_t)(rd % nr_of_dpus),
+                      .addr = (uint32_t)((rd / nr_of_dpus) % 8000000)};
+    });
+}
+
+inline auto lookup_task(const parlay::sequence<pptr>& addrs) {
+    return [&](size_t i) {
+        fixed_task t;
+        t.addr = addrs[i];
+        t.a[0] = i;
+        return t;
+    };
+}
+
+// Tasks pushed one by one through the typed view, whose ith() reads the
+// same replies as the untyped batch's.
+inline void typed_test(int n) {
+    auto addrs = random_addrs(n);
+    auto location = parlay::sequence<int>(n);
+    auto io = alloc_io_manager();
+    io->init();
+    auto batch = io->alloc_typed<fixed_task, fixed_reply, direct>();
+    auto taskf = lookup_task(addrs);
+    parlay::parallel_for(0, n, [&](size_t i) {
+        location[i] = batch.push_task(addrs[i].id, taskf(i), true);
+    });
+    io->finish_task_batch();
+    ASSERT(io->exec());
+    parlay::parallel_for(0, n, [&](size_t i) {
+        fixed_reply* reply = batch.ith(addrs[i].id, location[i]);
+        ASSERT(reply == batch.batch->ith(addrs[i].id, location[i]));
+        ASSERT(reply->a[0] == pptr_to_int64(addrs[i]));
+    });
+    io->reset();
+}
+
+// Repeated lookups of an address are sent once, and every copy reads the
+// shared reply.
+inline void dedup_test(int n, int distinct) {
+    auto pool = random_addrs(distinct);
+    auto addrs = parlay::tabulate(n, [&](size_t i) {
+        return pool[parlay::hash64(i) % distinct];
+    });
+    auto location = parlay::sequence<int>(n);
+    auto io = alloc_io_manager();
+    io->init();
+    auto batch = io->alloc<fixed_task, fixed_reply>(direct);
+    int sent = batch->push_task_from_array_dedup(
+        n,
+        [&](size_t i) {
+            fixed_task t;
+            t.addr = addrs[i];
+            t.a[0] = 0;
+            return t;
+        },
+        [&](size_t i) { return addrs[i].id; }, make_slice(location));
+    io->finish_task_batch();
+    auto unique_addrs = parlay::unique(parlay::sort(
+        parlay::map(addrs, [](pptr a) { return pptr_to_int64(a); })));
+    ASSERT(sent == (int)unique_addrs.size());
+    ASSERT(io->exec());
+    parlay::parallel_for(0, n, [&](size_t i) {
+        auto reply = (fixed_reply*)batch->ith(addrs[i].id, location[i]);
+        ASSERT(reply->a[0] == pptr_to_int64(addrs[i]));
+    });
+    io->reset();
+}
+
+// gather_replies copies the replies back into task order, the same ones
+// ith() finds one by one.
+inline void gather_test(int n) {
+    auto addrs = random_addrs(n);
+    auto location = parlay::sequence<int>(n);
+    auto io = alloc_io_manager();
+    io->init();
+    auto batch = io->alloc<fixed_task, fixed_reply>(direct);
+    batch->push_task_from_array_by_isort<true>(
+        n, lookup_task(addrs),
+        [&](const fixed_task& x) { return x.addr.id; }, make_slice(location));
+    io->finish_task_batch();
+    ASSERT(io->exec());
+
+    auto replies = parlay::sequence<fixed_reply>::uninitialized(n);
+    batch->gather_replies([&](size_t i) { return addrs[i].id; },
+                          make_slice(location), make_slice(replies));
+    parlay::parallel_for(0, n, [&](size_t i) {
+        auto reply = (fixed_reply*)batch->ith(addrs[i].id, location[i]);
+        ASSERT(replies[i].a[0] == reply->a[0]);
+        ASSERT(replies[i].a[0] == pptr_to_int64(addrs[i]));
+    });
+    io->reset();
+}
+
+// The replies of a single fixed length block land in caller memory, DPU
+// i's at landing + i * stride, instead of in the transfer buffer.
+inline void receive_into_test(int n) {
+    auto addrs = random_addrs(n);
+    auto location = parlay::sequence<int>(n);
+    auto io = alloc_io_manager();
+    io->init();
+    auto batch = io->alloc<fixed_task, fixed_reply>(direct);
+    batch->push_task_from_array_by_isort<true>(
+        n, lookup_task(addrs),
+        [&](const fixed_task& x) { return x.addr.id; }, make_slice(location));
+    io->finish_task_batch();
+
+    int64_t stride = (io->zero_copy_stride() + sizeof(fixed_reply) - 1) /
+                     sizeof(fixed_reply);
+    auto landing =
+        parlay::sequence<fixed_reply>::uninitialized(stride * nr_of_dpus);
+    ASSERT(io->receive_into(landing.data(), stride));
+    ASSERT(io->exec());
+    parlay::parallel_for(0, n, [&](size_t i) {
+        auto reply = (fixed_reply*)batch->ith(addrs[i].id, location[i]);
+        ASSERT(reply == &landing[addrs[i].id * stride + location[i]]);
+        ASSERT(reply->a[0] == pptr_to_int64(addrs[i]));
+    });
+    io->reset();
+}
+
+// Every task asks for length values from its address on, more than a DPU
+// can return in one epoch; the DPUs answer in pieces that fit.
+inline void continuation_test(int n, int64_t length) {
+    auto addrs = parlay::tabulate(n, [&](size_t i) {
+        return (pptr){.id = (uint32_t)(i % nr_of_dpus), .addr = (uint32_t)i};
+    });
+    auto received = parlay::sequence<int64_t>(n, 0);
+    int rounds = exec_with_continuation<chunk_task, chunk_reply>(
+        n,
+        [&](size_t i) {
+            chunk_task t;
+            t.addr = addrs[i];
+            t.length = length;
+            t.token = 0;
+            return t;
+        },
+        [&](size_t i) { return addrs[i].id; },
+        [&](chunk_task t, int64_t token) {
+            t.token = token;
+            return t;
+        },
+        [&](size_t i, uint8_t* payload, int bytes) {
+            int64_t* v = (int64_t*)payload;
+            int64_t first = pptr_to_int64(addrs[i]) + received[i];
+            for (int k = 0; k < bytes / (int)sizeof(int64_t); k++) {
+                ASSERT(v[k] == first + k);
+            }
+            received[i] += bytes / sizeof(int64_t);
+        });
+    ASSERT(rounds > 0);
+    parlay::parallel_for(0, n, [&](size_t i) { ASSERT(received[i] == length); });
+    printf("continuation: %d tasks in %d rounds\n", n, rounds);
+}
+
+// Two continuation batches spawned on one scheduler: each round of one
+// shares its epoch with the same round of the other.
+inline void shared_continuation_test(int n, int64_t length) {
+    epoch_coroutine::scheduler s;
+    parlay::sequence<int64_t> received[2];
+    int rounds[2];
+    for (int b = 0; b < 2; b++) {
+        received[b] = parlay::sequence<int64_t>(n, 0);
+        auto tasks = parlay::tabulate(n, [&](size_t i) {
+            chunk_task t;
+            t.addr = (pptr){.id = (uint32_t)(i % nr_of_dpus),
+                            .addr = (uint32_t)(b * n + i)};
+            t.length = length;
+            t.token = 0;
+            return t;
+        });
+        auto targets = parlay::tabulate(n, [&](size_t i) {
+            return (int)tasks[i].addr.id;
+        });
+        auto firsts = parlay::map(
+            tasks, [](const chunk_task& t) { return pptr_to_int64(t.addr); });
+        s.spawn(epoch_coroutine::continuation_batch<chunk_task, chunk_reply>(
+            s, std::move(tasks), std::move(targets),
+            [](chunk_task t, int64_t token) {
+                t.token = token;
+                return t;
+            },
+            [&received, b, firsts](size_t i, uint8_t* payload, int bytes) {
+                int64_t* v = (int64_t*)payload;
+                int64_t first = firsts[i] + received[b][i];
+                for (int k = 0; k < bytes / (int)sizeof(int64_t); k++) {
+                    ASSERT(v[k] == first + k);
+                }
+                received[b][i] += bytes / sizeof(int64_t);
+            },
+            &rounds[b]));
+    }
+    s.run();
+    for (int b = 0; b < 2; b++) {
+        ASSERT(rounds[b] > 0);
+        parlay::parallel_for(0, n, [&](size_t i) {
+            ASSERT(received[b][i] == length);
+        });
+    }
+    printf("shared continuation: 2 x %d tasks in %d and %d rounds\n", n,
+           rounds[0], rounds[1]);
+}
+
+// Range scans of span keys from op * 2 * span on, each over a group of G
+// DPUs. Even ops find their keys interleaved over the group (key k on the
+// DPU k % G), so the pieces overlap and are merged; odd ops find a quarter
+// of the range on each DPU, so the pieces are concatenated. The pieces come
+// back in chunks, and merge_scan_pieces assembles each scan's result.
+inline void scan_merge_test(int num_ops, int64_t span) {
+    const int G = 4;
+    int n = num_ops * G;
+    auto tasks = parlay::tabulate(n, [&](size_t i) {
+        int64_t o = i / G, q = i % G, l = o * 2 * span;
+        range_task t;
+        if (o % 2 == 0) {
+            t.first = l + q;
+            t.last = l + span;
+            t.stride = G;
+        } else {
+            t.first = l + q * span / G;
+            t.last = l + (q + 1) * span / G;
+            t.stride = 1;
+        }
+        t.token = 0;
+        return t;
+    });
+    auto results = parlay::sequence<vector<key_value>>(n);
+    int rounds = exec_with_continuation<range_task, range_reply>(
+        n, [&](size_t i) { return tasks[i]; },
+        [&](size_t i) { return (int)((i / G + i % G) % nr_of_dpus); },
+        [](range_task t, int64_t token) {
+            t.token = token;
+            return t;
+        },
+        [&](size_t i, uint8_t* payload, int bytes) {
+            key_value* kv = (key_value*)payload;
+            results[i].insert(results[i].end(), kv,
+                              kv + bytes / sizeof(key_value));
+        });
+    ASSERT(rounds > 0);
+
+    auto pieces = parlay::tabulate(n, [&](size_t i) {
+        return (scan_piece){.op = (int)(i / G),
+                            .data = results[i].data(),
+                            .length = (int64_t)results[i].size()};
+    });
+    auto merged = merge_scan_pieces(num_ops, pieces);
+    auto& kvs = merged.first;
+    auto& ranges = merged.second;
+    parlay::parallel_for(0, num_ops, [&](size_t o) {
+        int64_t l = o * 2 * span;
+        ASSERT(ranges[o].second - ranges[o].first == span);
+        for (int64_t k = 0; k < span; k++) {
+            ASSERT(kvs[ranges[o].first + k].key == l + k);
+        }
+    });
+    printf("scan merge: %d scans in %d rounds\n", num_ops, rounds);
+}
+
+// Point lookups and short range scans travel as two blocks of one epoch:
+// a single exec() answers both operation types.
+inline void mixed_epoch_test(int per_dpu, int64_t span) {
+    int n = nr_of_dpus * per_dpu;
+    auto target = [&](size_t i) { return (int)(i / per_dpu); };
+    auto addrs = parlay::tabulate(n, [&](size_t i) {
+        return (pptr){.id = (uint32_t)target(i), .addr = (uint32_t)i};
+    });
+    auto lookup_location = parlay::sequence<int>(n);
+    auto scan_location = parlay::sequence<int>(n);
+
+    auto io = alloc_io_manager();
+    io->init();
+    auto lookups = io->alloc<fixed_task, fixed_reply>(direct);
+    lookups->push_task_sorted(
+        n, nr_of_dpus,
+        [&](size_t i) {
+            fixed_task t;
+            t.addr = addrs[i];
+            t.a[0] = i;
+            return t;
+        },
+        target, make_slice(lookup_location));
+    io->finish_task_batch();
+    auto scans = io->alloc<range_task, range_reply>(direct);
+    scans->push_task_sorted(
+        n, nr_of_dpus,
+        [&](size_t i) {
+            range_task t;
+            t.first = i * span;
+            t.last = (i + 1) * span;
+            t.stride = 1;
+            t.token = 0;
+            return t;
+        },
+        target, make_slice(scan_location));
+    io->finish_task_batch();
+    ASSERT(io->exec());
+
+    parlay::parallel_for(0, n, [&](size_t i) {
+        auto r = (fixed_reply*)lookups->ith(target(i), lookup_location[i]);
+        ASSERT(r->a[0] == pptr_to_int64(addrs[i]));
+        int64_t* reply = (int64_t*)scans->ith(target(i), scan_location[i]);
+        int length =
+            scans->tbs[target(i)].ith_length(scan_location[i]);
+        ASSERT(reply[0] != CONTINUATION_MORE);
+        ASSERT(length == CONTINUATION_HEADER + span * (int)sizeof(key_value));
+        key_value* kv = (key_value*)((uint8_t*)reply + CONTINUATION_HEADER);
+        for (int64_t k = 0; k < span; k++) {
+            ASSERT(kv[k].key == (int64_t)i * span + k);
+        }
+    });
+    io->reset();
+    printf("mixed epoch: %d lookups and %d scans in one exec\n", n, n);
+}
+
 inline void clean_cache() {
     const int DEF = 5e6;
     int64_t* a = new int64_t[DEF];
@@ -101,7 +422,7 @@ inline void clean_cache() {
 
 inline void taskgen_test() {
     taskgen(false);
-    io_managers[0].reset();
+    io_managers[0]->reset();
     clean_cache();
 }
 
@@ -115,7 +436,15 @@ void test_task_framework(int dpus) {
         taskgen(true);
         dpu_control::print_log(
             [&](auto each_dpu) -> bool { return each_dpu < 10; });
-        io_managers[0].reset();
+        io_managers[0]->reset();
+        typed_test(nr_of_dpus * 256);
+        dedup_test(nr_of_dpus * 256, nr_of_dpus * 16);
+        gather_test(nr_of_dpus * 256);
+        receive_into_test(nr_of_dpus * 256);
+        continuation_test(nr_of_dpus * 64, 1 << 14);
+        shared_continuation_test(nr_of_dpus * 32, 1 << 14);
+        scan_merge_test(nr_of_dpus, 1 << 20);
+        mixed_epoch_test(64, 8);
     }
     timer::active = true;
     for (int i = 0; i < 1000; i++) {
@@ -9,6 +9,13 @@
 #define DPU_BLOCK_FIXLEN (0)
 #define DPU_BLOCK_VARLEN (1)
 
+// continuation replies: STATE(8) + RESUME_TOKEN(8) + PAYLOAD
+// the host re-issues the task with the token while STATE is CONTINUATION_MORE
+#define CONTINUATION_DONE (0)
+#define CONTINUATION_MORE (1)
+#define CONTINUATION_HEADER_I64 (2)
+#define CONTINUATION_HEADER ((int)S64(CONTINUATION_HEADER_I64))
+
 // constants
 #define MAX_IO_BLOCKS (10)
 
@@ -237,6 +237,33 @@ static inline void push_variable_reply_commit(int tasklet_id, int length) {
     push_variable_reply_zero_copy(tasklet_id, length);
 }
 
+// bytes this tasklet can still append to the current variable length block,
+// keeping room for the offset of one more reply
+static inline int64_t variable_reply_remaining(int tasklet_id) {
+    if (send_varlen_task_cnt[tasklet_id] >=
+        MAX_TASK_COUNT_PER_TASKLET_PER_BLOCK) {
+        return 0;
+    }
+    int64_t rem = MAX_TASK_BUFFER_SIZE_PER_TASKLET -
+                  send_varlen_task_size[tasklet_id] - sizeof(int64_t);
+    return rem > 0 ? rem : 0;
+}
+
+// A partial reply: payload_length bytes follow the returned pointer, and
+// CONTINUATION_HEADER + payload_length must fit in variable_reply_remaining.
+// With state == CONTINUATION_MORE the host resumes the task from token in a
+// following epoch.
+static inline mpuint8_t push_continuation_reply_zero_copy(
+    int tasklet_id, int64_t state, int64_t token, size_t payload_length) {
+    int64_t header[CONTINUATION_HEADER_I64];
+    header[0] = state;
+    header[1] = token;
+    mpuint8_t ptr = push_variable_reply_zero_copy(
+        tasklet_id, CONTINUATION_HEADER + payload_length);
+    mram_write(header, ptr, CONTINUATION_HEADER);
+    return ptr + CONTINUATION_HEADER;
+}
+
 static inline void finish_fixed_reply(int length, int tasklet_id) {
     TASK_IN_DPU_ASSERT(send_block_content_type == DPU_BLOCK_FIXLEN,
                        "finish fixed reply: wrong type\n");
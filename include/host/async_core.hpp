@@ -0,0 +1,321 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+#include "driver.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// Per-operation front end over core. Callers on any thread submit single
+// operations and get a future; batcher threads drain the per-type queues
+// into core batches once a queue holds execute_batch_size operations or
+// its oldest operation has waited for the batch window.
+// Operations in different batches are not ordered against each other.
+namespace async_core {
+
+// Vyukov's bounded multi-producer multi-consumer queue. An element is
+// only constructed while its cell is full, so empty slots cost no
+// allocations (a promise allocates its shared state).
+template <typename T>
+class mpmc_queue {
+    struct cell {
+        atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* data() { return reinterpret_cast<T*>(storage); }
+    };
+
+    vector<cell> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> head;
+    alignas(64) atomic<size_t> tail;
+
+   public:
+    // capacity is rounded up to a power of two
+    explicit mpmc_queue(size_t capacity) : head(0), tail(0) {
+        size_t c = 2;
+        while (c < capacity) c <<= 1;
+        cells = vector<cell>(c);
+        mask = c - 1;
+        for (size_t i = 0; i < c; i++) {
+            cells[i].seq.store(i, memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_queue() {
+        T v;
+        while (try_pop(v)) {
+        }
+    }
+
+    bool try_push(T&& v) {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true) {
+            cell& c = cells[pos & mask];
+            size_t seq = c.seq.load(memory_order_acquire);
+            int64_t dif = (int64_t)seq - (int64_t)pos;
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1,
+                                               memory_order_relaxed)) {
+                    new (c.data()) T(std::move(v));
+                    c.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;  // full
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& v) {
+        size_t pos = head.load(memory_order_relaxed);
+        while (true) {
+            cell& c = cells[pos & mask];
+            size_t seq = c.seq.load(memory_order_acquire);
+            int64_t dif = (int64_t)seq - (int64_t)(pos + 1);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1,
+                                               memory_order_relaxed)) {
+                    v = std::move(*c.data());
+                    c.data()->~T();
+                    c.seq.store(pos + mask + 1, memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;  // empty
+            } else {
+                pos = head.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t size() {
+        size_t t = tail.load(memory_order_relaxed);
+        size_t h = head.load(memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+};
+
+using clock_type = chrono::steady_clock;
+
+template <typename Op, typename Result>
+struct request {
+    Op op;
+    promise<Result> result;
+    function<void()> notify;  // optional, called once the result is set
+
+    void finish(Result r) {
+        result.set_value(std::move(r));
+        if (notify) notify();
+    }
+};
+
+// One queue per operation type, plus the arrival time of the oldest
+// operation not yet taken by a batcher (0 when none is pending).
+template <typename Op, typename Result>
+struct op_queue {
+    mpmc_queue<request<Op, Result>> q;
+    atomic<int64_t> oldest;
+
+    explicit op_queue(size_t capacity) : q(capacity), oldest(0) {}
+
+    static int64_t now() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   clock_type::now().time_since_epoch())
+            .count();
+    }
+
+    future<Result> submit(const Op& op, function<void()> notify = nullptr) {
+        request<Op, Result> r{op, promise<Result>(), std::move(notify)};
+        future<Result> f = r.result.get_future();
+        while (!q.try_push(std::move(r))) {
+            this_thread::yield();  // full: back pressure on the submitter
+        }
+        int64_t expected = 0;
+        oldest.compare_exchange_strong(expected, now());
+        return f;
+    }
+
+    bool ready(size_t batch_size, int64_t window_ns) {
+        size_t n = q.size();
+        if (n == 0) return false;
+        if (n >= batch_size) return true;
+        int64_t o = oldest.load();
+        return o != 0 && now() - o >= window_ns;
+    }
+
+    parlay::sequence<request<Op, Result>> drain(size_t batch_size) {
+        oldest.store(0);
+        parlay::sequence<request<Op, Result>> reqs;
+        request<Op, Result> r;
+        while (reqs.size() < batch_size && q.try_pop(r)) {
+            reqs.push_back(std::move(r));
+        }
+        if (q.size() > 0) {
+            // left over operations have waited at least since now
+            int64_t expected = 0;
+            oldest.compare_exchange_strong(expected, now());
+        }
+        return reqs;
+    }
+};
+
+const size_t DEFAULT_QUEUE_CAPACITY = (1 << 16);
+
+class async_front_end {
+   public:
+    // keys, or key-value pairs: the columns core takes
+    op_queue<int64_t, key_value> gets;
+    op_queue<int64_t, key_value> predecessors;
+    op_queue<key_value, bool> inserts;
+    op_queue<int64_t, bool> removes;
+    op_queue<scan_operation, parlay::sequence<key_value>> scans;
+
+    size_t execute_batch_size;
+    int64_t window_ns;
+    int num_batchers;
+    atomic<bool> stopping;
+
+    async_front_end(size_t _execute_batch_size, int64_t window_us,
+                    int _num_batchers,
+                    size_t capacity = DEFAULT_QUEUE_CAPACITY)
+        : gets(capacity),
+          predecessors(capacity),
+          inserts(capacity),
+          removes(capacity),
+          scans(capacity),
+          execute_batch_size(_execute_batch_size),
+          window_ns(window_us * 1000),
+          num_batchers(_num_batchers),
+          stopping(false) {
+        ASSERT(num_batchers >= 1 &&
+               num_batchers <= core::num_top_level_threads);
+    }
+
+    // notify, if given, runs on the batcher right after the result is set
+    future<key_value> get(int64_t key, function<void()> notify = nullptr) {
+        return gets.submit(key, std::move(notify));
+    }
+
+    future<key_value> predecessor(int64_t key,
+                                  function<void()> notify = nullptr) {
+        return predecessors.submit(key, std::move(notify));
+    }
+
+    future<bool> insert(int64_t key, int64_t value,
+                        function<void()> notify = nullptr) {
+        return inserts.submit((key_value){.key = key, .value = value},
+                              std::move(notify));
+    }
+
+    future<bool> remove(int64_t key, function<void()> notify = nullptr) {
+        return removes.submit(key, std::move(notify));
+    }
+
+    future<parlay::sequence<key_value>> scan(
+        int64_t lkey, int64_t rkey, function<void()> notify = nullptr) {
+        return scans.submit((scan_operation){.lkey = lkey, .rkey = rkey},
+                            std::move(notify));
+    }
+
+    // Runs clients() on the calling worker while num_batchers other parlay
+    // workers execute the queued operations, like the threads of
+    // core::execute; returns once clients() has returned and every pending
+    // operation is done. Batchers must be parlay workers: core and the IO
+    // managers key per-thread state on worker_id(), which a plain thread
+    // would share with worker 0. clients() may submit from plain threads.
+    template <typename F>
+    void serve(F clients) {
+        ASSERT((int)parlay::num_workers() > num_batchers);
+        stopping = false;
+        parlay::par_do(
+            [&]() {
+                clients();
+                stopping = true;
+            },
+            [&]() {
+                parlay::parallel_for(
+                    0, num_batchers, [&](size_t tid) { batcher(tid); }, 1);
+            });
+    }
+
+   private:
+    template <typename Op, typename Result, typename Run>
+    bool try_run(op_queue<Op, Result>& queue, size_t batch_size,
+                 bool flush, Run run) {
+        if (!queue.ready(batch_size, flush ? 0 : window_ns)) {
+            return false;
+        }
+        auto reqs = queue.drain(batch_size);
+        if (reqs.size() == 0) {
+            return false;
+        }
+        auto ops = parlay::tabulate(reqs.size(),
+                                    [&](size_t i) { return reqs[i].op; });
+        run(make_slice(ops), make_slice(reqs));
+        return true;
+    }
+
+    void batcher(int tid) {
+        mutex batch_mutex;  // core functions release the load lock
+        pim_skip_list* ds = &pim_skip_list_drivers[tid];
+        size_t scan_batch_size = max<size_t>(execute_batch_size / 100, 1);
+        while (true) {
+            bool flush = stopping.load();
+            bool worked = false;
+            worked |= try_run(gets, execute_batch_size, flush,
+                              [&](auto ops, auto reqs) {
+                                  unique_lock<mutex> lock(batch_mutex);
+                                  core::get(ops, lock, tid);
+                                  for (size_t i = 0; i < reqs.size(); i++) {
+                                      reqs[i].finish(ds->kv_output[i]);
+                                  }
+                              });
+            worked |= try_run(predecessors, execute_batch_size, flush,
+                              [&](auto ops, auto reqs) {
+                                  unique_lock<mutex> lock(batch_mutex);
+                                  core::predecessor(ops, lock, tid);
+                                  for (size_t i = 0; i < reqs.size(); i++) {
+                                      reqs[i].finish(ds->kv_output[i]);
+                                  }
+                              });
+            worked |= try_run(inserts, execute_batch_size, flush,
+                              [&](auto ops, auto reqs) {
+                                  unique_lock<mutex> lock(batch_mutex);
+                                  core::insert(ops, lock, tid);
+                                  for (auto& r : reqs) r.finish(true);
+                              });
+            worked |= try_run(removes, execute_batch_size, flush,
+                              [&](auto ops, auto reqs) {
+                                  unique_lock<mutex> lock(batch_mutex);
+                                  core::remove(ops, lock, tid);
+                                  for (auto& r : reqs) r.finish(true);
+                              });
+            worked |= try_run(
+                scans, scan_batch_size, flush, [&](auto ops, auto reqs) {
+                    unique_lock<mutex> lock(batch_mutex);
+                    auto res = core::scan(ops, lock, tid);
+                    for (size_t i = 0; i < reqs.size(); i++) {
+                        auto range = res.second[i];
+                        reqs[i].finish(parlay::tabulate(
+                            range.second - range.first, [&](size_t j) {
+                                return res.first[range.first + j];
+                            }));
+                    }
+                });
+            if (!worked) {
+                if (flush) break;
+                this_thread::sleep_for(chrono::microseconds(
+                    max<int64_t>(window_ns / 4000, 1)));
+            }
+        }
+    }
+};
+
+};  // namespace async_core
@@ -8,14 +8,18 @@
 #include <shared_mutex>
 #include "fcntl.h"
 #include "oracle.hpp"
+#include "result_verifier.hpp"
 #include "operation_def.hpp"
+#include "op_file.hpp"
 #include "timer.hpp"
 #include "test_generator.hpp"
+#include "ycsb_generator.hpp"
 #include "operation.hpp"
 #include "parlay/papi/papi_util_impl.h"
 #include <unistd.h>
 #include <sys/stat.h>
 #include <filesystem>
+#include <memory>
 
 using namespace std;
 using namespace parlay;
@@ -47,6 +51,10 @@ void dpu_energy_stats(bool flag = false) {
 
 inline void write_ops_to_file(string file_name,
                               slice<operation*, operation*> ops) {
+    if (op_file_columnar) {
+        write_op_file(file_name, ops);
+        return;
+    }
     printf("Will write to '%s'\n", file_name.c_str());
 
     /* Open a file for writing.
@@ -121,8 +129,6 @@ inline void write_ops_to_file(string file_name,
     close(fd);
 }
 
-bool Check_result = false;
-
 template <typename Checker>
 auto read_op_file(string name, Checker checker) {
     const char* filepath = name.c_str();
@@ -174,6 +180,7 @@ auto read_op_file(string name, Checker checker) {
 namespace core {
 
 batch_parallel_oracle oracle;
+result_verifier verifier(oracle);
 bool check_result = true;
 atomic<int> batch_number = 0;
 
@@ -183,17 +190,18 @@ int push_pull_limit_dynamic;
 
 shared_mutex op_mutex;
 
-void get(slice<get_operation*, get_operation*> ops, unique_lock<mutex>& mut, int tid = 0) {
+void get(slice<int64_t*, int64_t*> keys, unique_lock<mutex>& mut, int tid = 0) {
     parlay::sequence<int64_t> ops_sequence;
+    parlay::sequence<size_t> picked;
     pim_skip_list* ds = &pim_skip_list_drivers[tid];
-    int n = ops.size();
+    int n = keys.size();
     {
         if (check_result) {
+            picked = verifier.sample(n);
             ops_sequence =
-                parlay::tabulate(n, [&](size_t i) { return ops[i].key; });
+                parlay::map(picked, [&](size_t i) { return keys[i]; });
         }
-        auto ops2 = make_slice((int64_t*)ops.begin(), (int64_t*)ops.end());
-        time_nested("get load", [&]() { ds->get_load(ops2); });
+        time_nested("get load", [&]() { ds->get_load(keys); });
         mut.unlock();
     }
 
@@ -204,42 +212,32 @@ void get(slice<get_operation*, get_operation*> ops, unique_lock<mutex>& mut, int
             ds->get();
         });
         if (check_result) {
-            auto v1 = parlay::make_slice(ds->kv_output, ds->kv_output + n);
-            auto pred = oracle.predecessor_batch(make_slice(ops_sequence));
-            auto v2 = parlay::tabulate(pred.size(), [&](size_t i) {
-                if (pred[i].key != ops_sequence[i]) {
-                    return (key_value){.key = INT64_MIN, .value = INT64_MIN};
-                } else {
-                    return pred[i];
-                }
-            });
-            if (!parlay::equal(v1, v2)) {
-                int n = v1.size();
-                for (int i = 0; i < n; i++) {
-                    if (v1[i] != v2[i]) {
-                        printf("[%8d]\t", i);
-                        cout << "k=" << ops[i].key << "\tv1=" << v1[i]
-                             << "\tv2=" << v2[i] << endl;
-                    }
-                }
-            }
+            verifier.get(std::move(ops_sequence),
+                         parlay::map(picked, [&](size_t i) {
+                             return ds->kv_output[i];
+                         }));
         }
     }
 }
 
-void update(slice<update_operation*, update_operation*> ops,
-            unique_lock<mutex>& mut, int tid = 0) {
+// still unsupported: the skip list has no update epoch
+void update(slice<key_value*, key_value*> kvs, unique_lock<mutex>& mut,
+            int tid = 0) {
+    (void)kvs;
+    (void)mut;
+    (void)tid;
     assert(false);
 }
 
 // Range Scan
-void scan(slice<scan_operation*, scan_operation*> ops, unique_lock<mutex>& mut, int tid = 0,
+// returns all results and each operation's [first, second) range in them
+auto scan(slice<scan_operation*, scan_operation*> ops, unique_lock<mutex>& mut, int tid = 0,
           bool reset_len=false, int64_t expected_length = 100, uint64_t dataset_size=500000000) {
     pim_skip_list* ds = &pim_skip_list_drivers[tid];
     if(reset_len) {
         int64_t range_size;
         if(check_result)
-            range_size = UINT64_MAX / oracle.inserted.size() * expected_length;
+            range_size = UINT64_MAX / verifier.oracle_size * expected_length;
         else
             range_size = UINT64_MAX / dataset_size * expected_length;
         parfor_wrap(0, ops.size(), [&](size_t i) {
@@ -258,56 +256,30 @@ void scan(slice<scan_operation*, scan_operation*> ops, unique_lock<mutex>& mut,
     time_start("scan");
     auto v1 = ds->scan(ops);
     time_end("scan");
-    if (Check_result) {
-        int64_t length = ops.size();
-        auto v2 = oracle.scan_size_batch(ops);
-        bool correct = true;
-        parlay::parallel_for(0, length, [&](size_t i) {
-            if (correct) {
-                if ((v2[i].second - v2[i].first) !=
-                    (v1.second[i].second - v1.second[i].first)) {
-                    correct = false;
-                }
-            }
-        });
-        if (!correct) {
-            int64_t v1l, v2l, res = 0, print_num = 0;
-            for (int64_t i = 0; i < length; i++) {
-                v1l = v1.second[i].second - v1.second[i].first;
-                v2l = v2[i].second - v2[i].first;
-                if (v2l != v1l) {
-                    if(print_num < 10){
-                        printf(
-                            "k=(%lld,%lld) v1_s=%lld v2_s=%lld (%lld, %lld; %lld, %lld) (%lld, %lld; %lld, %lld)\n",
-                            ops[i].lkey, ops[i].rkey, v1l, v2l,
-                            v1.first[v1.second[i].first - 1].key, v1.first[v1.second[i].first].key,
-                            v1.first[v1.second[i].second].key, v1.first[v1.second[i].second + 1].key,
-                            oracle.inserted[v2[i].first - 1].key, oracle.inserted[v2[i].first].key,
-                            oracle.inserted[v2[i].second].key, oracle.inserted[v2[i].second + 1].key
-                        );
-                        print_num++;
-                    }
-                    res++;
-                }
-            }
-            cout << "Number of Errorness: " << res << endl;
-            cout << "kv_set size returned: " << v1.first.size() << endl;
-        }
+    if (check_result) {
+        auto picked = verifier.sample(ops.size());
+        verifier.scan(
+            parlay::map(picked, [&](size_t i) { return ops[i]; }),
+            parlay::map(picked, [&](size_t i) -> int64_t {
+                return v1.second[i].second - v1.second[i].first;
+            }));
     }
+    return v1;
 }
 
-void predecessor(slice<predecessor_operation*, predecessor_operation*> ops,
-                 unique_lock<mutex>& mut, int tid = 0) {
+void predecessor(slice<int64_t*, int64_t*> keys, unique_lock<mutex>& mut,
+                 int tid = 0) {
     parlay::sequence<int64_t> ops_sequence;
-    int n = ops.size();
+    parlay::sequence<size_t> picked;
+    int n = keys.size();
     pim_skip_list* ds = &pim_skip_list_drivers[tid];
     {
         if (check_result) {
+            picked = verifier.sample(n);
             ops_sequence =
-                parlay::tabulate(n, [&](size_t i) { return ops[i].key; });
+                parlay::map(picked, [&](size_t i) { return keys[i]; });
         }
-        auto ops2 = make_slice((int64_t*)ops.begin(), (int64_t*)ops.end());
-        time_nested("predecessor load", [&]() { ds->predecessor_load(ops2); });
+        time_nested("predecessor load", [&]() { ds->predecessor_load(keys); });
         mut.unlock();
     }
     {
@@ -317,34 +289,25 @@ void predecessor(slice<predecessor_operation*, predecessor_operation*> ops,
         time_nested("predecessor", [&]() { ds->predecessor(); });
 
         if (check_result) {
-            auto v1 = parlay::make_slice(ds->kv_output, ds->kv_output + n);
-            auto v2 = oracle.predecessor_batch(make_slice(ops_sequence));
-            if (!parlay::equal(v1, v2)) {
-                int n = v1.size();
-                for (int i = 0; i < n; i++) {
-                    if (v1[i] != v2[i]) {
-                        printf("[%8d]\t", i);
-                        cout << "k=" << ops[i].key << "\tv1=" << v1[i]
-                             << "\tv2=" << v2[i] << endl;
-                    }
-                }
-            }
+            verifier.predecessor(std::move(ops_sequence),
+                                 parlay::map(picked, [&](size_t i) {
+                                     return ds->kv_output[i];
+                                 }));
         }
     }
 }
 
-void insert(slice<insert_operation*, insert_operation*> ops,
-            unique_lock<mutex>& mut, int tid = 0) {
+void insert(slice<key_value*, key_value*> kvs, unique_lock<mutex>& mut,
+            int tid = 0) {
     parlay::sequence<key_value> ops_sequence;
-    int n = ops.size();
+    int n = kvs.size();
     pim_skip_list* ds = &pim_skip_list_drivers[tid];
     {
         if (check_result) {
             ops_sequence =
-                parlay::tabulate(n, [&](size_t i) { return (key_value){.key = ops[i].key, .value = ops[i].value}; });
+                parlay::tabulate(n, [&](size_t i) { return kvs[i]; });
         }
-        auto ops2 = make_slice((key_value*)ops.begin(), (key_value*)ops.end());
-        time_nested("insert load", [&]() { ds->insert_load(ops2); });
+        time_nested("insert load", [&]() { ds->insert_load(kvs); });
         mut.unlock();
     }
     {
@@ -352,23 +315,22 @@ void insert(slice<insert_operation*, insert_operation*> ops,
         cout << (batch_number++) << " " << __FUNCTION__ << " " << tid << " " << n << endl;
         time_nested("insert", [&]() { ds->insert(); });
         if (check_result) {
-            oracle.insert_batch(make_slice(ops_sequence));
+            verifier.insert(std::move(ops_sequence));
         }
     }
 }
 
-void remove(slice<remove_operation*, remove_operation*> ops,
-            unique_lock<mutex>& mut, int tid = 0) {
+void remove(slice<int64_t*, int64_t*> keys, unique_lock<mutex>& mut,
+            int tid = 0) {
     parlay::sequence<int64_t> ops_sequence;
-    int n = ops.size();
+    int n = keys.size();
     pim_skip_list* ds = &pim_skip_list_drivers[tid];
     {
         if (check_result) {
             ops_sequence =
-                parlay::tabulate(n, [&](size_t i) { return ops[i].key; });
+                parlay::tabulate(n, [&](size_t i) { return keys[i]; });
         }
-        auto ops2 = make_slice((int64_t*)ops.begin(), (int64_t*)ops.end());
-        time_nested("remove load", [&]() { ds->remove_load(ops2); });
+        time_nested("remove load", [&]() { ds->remove_load(keys); });
         mut.unlock();
     }
     {
@@ -376,45 +338,233 @@ void remove(slice<remove_operation*, remove_operation*> ops,
         cout << (batch_number++) << " " << __FUNCTION__ << " " << tid  << " " << n << endl;
         time_nested("remove", [&]() { ds->remove(); });
         if (check_result) {
-            oracle.remove_batch(make_slice(ops_sequence));
+            verifier.remove(std::move(ops_sequence));
         }
     }
 }
 
+// Loading is lock free. Top level threads claim rounds of load_batch_size
+// operations with a fetch_add and partition each round by type into
+// per-type rings holding the operation_batch columns. A loader reserves a range of every
+// ring in round order, fills it and commits it in reservation order; threads claim
+// committed ranges as batches, copy them out and release them in claim
+// order. All ring counters only grow.
+template <typename T>
+struct op_ring {
+    parlay::sequence<T> data;
+    int64_t capacity;
+    alignas(64) atomic<int64_t> reserved;
+    alignas(64) atomic<int64_t> committed;
+    alignas(64) atomic<int64_t> claimed;
+    alignas(64) atomic<int64_t> released;
+
+    // storage is kept for later runs, and only touched as far as it is used
+    void init(int64_t _capacity) {
+        if ((int64_t)data.size() < _capacity) {
+            data = parlay::sequence<T>::uninitialized(_capacity);
+        }
+        capacity = _capacity;
+        reserved = committed = claimed = released = 0;
+    }
+
+    T& operator[](int64_t i) { return data[i % capacity]; }
+
+    // publishes [from, to) once everything before it is published
+    static void advance(atomic<int64_t>& c, int64_t from, int64_t to) {
+        while (c.load(memory_order_acquire) != from) {
+            this_thread::yield();
+        }
+        c.store(to, memory_order_release);
+    }
+
+    bool has_space(int64_t end) { return end - released.load() <= capacity; }
+
+    bool try_claim(int64_t min_take, int64_t max_take, int64_t& start,
+                   int64_t& len) {
+        int64_t c = claimed.load();
+        while (true) {
+            int64_t avail = committed.load(memory_order_acquire) - c;
+            if (avail <= 0 || avail < min_take) {
+                return false;
+            }
+            len = min(avail, max_take);
+            if (claimed.compare_exchange_weak(c, c + len)) {
+                start = c;
+                return true;
+            }
+        }
+    }
+
+    // copies [start, start + len) into a column of batch, and releases it
+    operation_batch::column_t<T> take(int64_t start, int64_t len,
+                                      operation_batch& batch) {
+        auto ret = batch.column<T>(len);
+        parlay::parallel_for(0, len, [&](size_t i) {
+            ret[i] = (*this)[start + (int64_t)i];
+        });
+        advance(released, start, start + len);
+        return ret;
+    }
+};
+
+op_ring<int64_t> get_ring;
+op_ring<key_value> update_ring;
+op_ring<int64_t> predecessor_ring;
+op_ring<scan_operation> scan_ring;
+op_ring<key_value> insert_ring;
+op_ring<int64_t> remove_ring;
+
+// one reusable batch per top level thread
+unique_ptr<operation_batch[]> thread_batches;
+int num_thread_batches = 0;
+
 const int _block_size = 1000;
-int l;
-parlay::sequence<size_t>* sums;
-int cnts[OPERATION_NR_ITEMS];
+const int SCAN_BATCH = 10000;
 int n, rounds;
-int T;
-
-void init(parlay::slice<operation*, operation*> ops, int load_batch_size,
-          int execute_batch_size) {
-    memset(op_count, 0, sizeof(op_count));
-    l = parlay::internal::num_blocks(load_batch_size, _block_size);
-    sums = new parlay::sequence<size_t>[OPERATION_NR_ITEMS];
-    for (int i = 0; i < OPERATION_NR_ITEMS; i++) {
-        sums[i] = parlay::sequence<size_t>(l);
-        cnts[i] = 0;
-    }
-    n = ops.size();
+int load_size;
+int default_batch_size;
+atomic<int> next_round;
+atomic<int> reserve_turn;
+atomic<int> loaded_rounds;
+
+// a ring holds one of the largest batches (max_batch_size - 1 +
+// load_batch_size operations) per thread, plus one filling up
+void init(int64_t num_ops, int load_batch_size, int execute_batch_size,
+          int max_batch_size, int threads) {
+    int64_t capacity =
+        (threads + 1) * ((int64_t)max_batch_size + load_batch_size);
+    get_ring.init(capacity);
+    update_ring.init(capacity);
+    predecessor_ring.init(capacity);
+    scan_ring.init(capacity);
+    insert_ring.init(capacity);
+    remove_ring.init(capacity);
+    if (num_thread_batches < threads) {
+        thread_batches = make_unique<operation_batch[]>(threads);
+        num_thread_batches = threads;
+    }
+    n = num_ops;
     rounds = parlay::internal::num_blocks(n, load_batch_size);
-    T = 0;
+    load_size = load_batch_size;
+    default_batch_size = execute_batch_size;
+    next_round = 0;
+    reserve_turn = 0;
+    loaded_rounds = 0;
+}
+
+struct claimed_batch {
+    operation_t type;
+    int64_t start, len;
+};
+
+// A ready batch of the first type holding batch_size operations, or of
+// scans holding batch_size / 100; with flush, any non empty one.
+claimed_batch claim_batch(int batch_size, bool flush) {
+    claimed_batch b = {operation_t::empty_t, 0, 0};
+    int64_t max_take = batch_size + load_size - 1;
+    auto try_ring = [&](auto& ring, operation_t t, int64_t min_take,
+                        int64_t max_len) {
+        if (b.type == operation_t::empty_t &&
+            ring.try_claim(flush ? 1 : min_take, max_len, b.start, b.len)) {
+            b.type = t;
+        }
+    };
+    try_ring(get_ring, operation_t::get_t, batch_size, max_take);
+    try_ring(update_ring, operation_t::update_t, batch_size, max_take);
+    try_ring(predecessor_ring, operation_t::predecessor_t, batch_size,
+             max_take);
+    try_ring(insert_ring, operation_t::insert_t, batch_size, max_take);
+    try_ring(remove_ring, operation_t::remove_t, batch_size, max_take);
+    try_ring(scan_ring, operation_t::scan_t, max(batch_size / 100, 1),
+             SCAN_BATCH);
+    return b;
 }
 
-mutex load_batch_mutex;
+// Executes the non empty columns of a batch, in operation_t order.
+void run(operation_batch& batch, int tid) {
+    mutex batch_mutex;  // nothing to hand back: the columns are private
+    auto locked = [&]() { return unique_lock<mutex>(batch_mutex); };
+    if (batch.get_keys.size() > 0) {
+        auto mut = locked();
+        core::get(batch.get_keys, mut, tid);
+    }
+    if (batch.update_kvs.size() > 0) {
+        auto mut = locked();
+        core::update(batch.update_kvs, mut, tid);
+    }
+    if (batch.predecessor_keys.size() > 0) {
+        auto mut = locked();
+        core::predecessor(batch.predecessor_keys, mut, tid);
+    }
+    if (batch.scans.size() > 0) {
+        auto mut = locked();
+        core::scan(batch.scans, mut, tid);
+    }
+    if (batch.insert_kvs.size() > 0) {
+        auto mut = locked();
+        core::insert(batch.insert_kvs, mut, tid);
+    }
+    if (batch.remove_keys.size() > 0) {
+        auto mut = locked();
+        core::remove(batch.remove_keys, mut, tid);
+    }
+}
 
-bool load_one_batch(parlay::slice<operation*, operation*> ops,
-                    int load_batch_size) {
+void run_batch(claimed_batch b, int tid) {
+    operation_batch& batch = thread_batches[tid];
+    batch.clear();
+    switch (b.type) {
+        case operation_t::get_t: {
+            batch.get_keys = get_ring.take(b.start, b.len, batch);
+            break;
+        }
+        case operation_t::update_t: {
+            batch.update_kvs = update_ring.take(b.start, b.len, batch);
+            break;
+        }
+        case operation_t::predecessor_t: {
+            batch.predecessor_keys =
+                predecessor_ring.take(b.start, b.len, batch);
+            break;
+        }
+        case operation_t::scan_t: {
+            batch.scans = scan_ring.take(b.start, b.len, batch);
+            break;
+        }
+        case operation_t::insert_t: {
+            batch.insert_kvs = insert_ring.take(b.start, b.len, batch);
+            break;
+        }
+        case operation_t::remove_t: {
+            batch.remove_keys = remove_ring.take(b.start, b.len, batch);
+            break;
+        }
+        default: {
+            assert(false);
+            break;
+        }
+    }
+    run(batch, tid);
+}
+
+// ops: a slice of operations, or an op_file_reader decoding them on demand
+template <typename Source>
+bool load_one_batch(Source& ops, int tid) {
+    int T = next_round.fetch_add(1);
     if (T >= rounds) {
         return false;
     }
-    int l = T * load_batch_size;
-    int r = min((T + 1) * load_batch_size, n);
+    int l = T * load_size;
+    int r = min((T + 1) * load_size, n);
     int len = r - l;
 
     auto mixed_op_batch = ops.cut(l, r);
 
+    int blocks = parlay::internal::num_blocks(len, _block_size);
+    parlay::sequence<size_t> sums[OPERATION_NR_ITEMS];
+    for (int j = 0; j < OPERATION_NR_ITEMS; j++) {
+        sums[j] = parlay::sequence<size_t>(blocks);
+    }
     parlay::internal::sliced_for(
         len, _block_size, [&](size_t i, size_t s, size_t e) {
             size_t c[OPERATION_NR_ITEMS] = {0};
@@ -428,15 +578,50 @@ bool load_one_batch(parlay::slice<operation*, operation*> ops,
                 sums[j][i] = c[j];
             }
         });
+    int64_t cnts[OPERATION_NR_ITEMS];
     for (int j = 0; j < OPERATION_NR_ITEMS; j++) {
         cnts[j] = parlay::scan_inplace(parlay::make_slice(sums[j]),
                                        parlay::addm<size_t>());
     }
+
+    // rounds reserve in order, so any two loaders are ordered the same way
+    // in every ring and the oldest waiting one never waits on a younger one
+    while (reserve_turn.load(memory_order_acquire) != T) {
+        this_thread::yield();
+    }
+    int64_t base[OPERATION_NR_ITEMS] = {0};
+    base[operation_t::get_t] = get_ring.reserved.fetch_add(cnts[operation_t::get_t]);
+    base[operation_t::update_t] = update_ring.reserved.fetch_add(cnts[operation_t::update_t]);
+    base[operation_t::predecessor_t] = predecessor_ring.reserved.fetch_add(cnts[operation_t::predecessor_t]);
+    base[operation_t::scan_t] = scan_ring.reserved.fetch_add(cnts[operation_t::scan_t]);
+    base[operation_t::insert_t] = insert_ring.reserved.fetch_add(cnts[operation_t::insert_t]);
+    base[operation_t::remove_t] = remove_ring.reserved.fetch_add(cnts[operation_t::remove_t]);
+    reserve_turn.store(T + 1, memory_order_release);
+
+    // a full ring only drains by running its batches, so help instead of
+    // waiting for the other threads
+    auto fits = [&](auto& ring, operation_t t) {
+        return ring.has_space(base[t] + cnts[t]);
+    };
+    while (!(fits(get_ring, operation_t::get_t) &&
+             fits(update_ring, operation_t::update_t) &&
+             fits(predecessor_ring, operation_t::predecessor_t) &&
+             fits(scan_ring, operation_t::scan_t) &&
+             fits(insert_ring, operation_t::insert_t) &&
+             fits(remove_ring, operation_t::remove_t))) {
+        claimed_batch b = claim_batch(default_batch_size, true);
+        if (b.type != operation_t::empty_t) {
+            run_batch(b, tid);
+        } else {
+            this_thread::yield();
+        }
+    }
+
     parlay::internal::sliced_for(
         len, _block_size, [&](size_t i, size_t s, size_t e) {
-            size_t c[OPERATION_NR_ITEMS];
+            int64_t c[OPERATION_NR_ITEMS];
             for (int j = 0; j < OPERATION_NR_ITEMS; j++) {
-                c[j] = sums[j][i] + op_count[j];
+                c[j] = sums[j][i] + base[j];
             }
             for (size_t j = s; j < e; j++) {
                 
@@ -446,27 +631,29 @@ bool load_one_batch(parlay::slice<operation*, operation*> ops,
                 int x = (int)operation_type;
                 switch (operation_type) {
                     case operation_t::get_t: {
-                        get_ops[c[x]++] = t.tsk.g;
+                        get_ring[c[x]++] = t.tsk.g.key;
                         break;
                     }
                     case operation_t::update_t: {
-                        update_ops[c[x]++] = t.tsk.u;
+                        update_ring[c[x]++] = (key_value){
+                            .key = t.tsk.u.key, .value = t.tsk.u.value};
                         break;
                     }
                     case operation_t::predecessor_t: {
-                        predecessor_ops[c[x]++] = t.tsk.p;
+                        predecessor_ring[c[x]++] = t.tsk.p.key;
                         break;
                     }
                     case operation_t::scan_t: {
-                        scan_ops[c[x]++] = t.tsk.s;
+                        scan_ring[c[x]++] = t.tsk.s;
                         break;
                     }
                     case operation_t::insert_t: {
-                        insert_ops[c[x]++] = t.tsk.i;
+                        insert_ring[c[x]++] = (key_value){
+                            .key = t.tsk.i.key, .value = t.tsk.i.value};
                         break;
                     }
                     case operation_t::remove_t: {
-                        remove_ops[c[x]++] = t.tsk.r;
+                        remove_ring[c[x]++] = t.tsk.r.key;
                         break;
                     }
                     default: {
@@ -475,98 +662,124 @@ bool load_one_batch(parlay::slice<operation*, operation*> ops,
                 }
             }
         });
-    for (int j = 0; j < OPERATION_NR_ITEMS; j++) {
-        op_count[j] += cnts[j];
-    }
-    T++;
+
+    auto commit = [&](auto& ring, operation_t t) {
+        ring.advance(ring.committed, base[t], base[t] + cnts[t]);
+    };
+    commit(get_ring, operation_t::get_t);
+    commit(update_ring, operation_t::update_t);
+    commit(predecessor_ring, operation_t::predecessor_t);
+    commit(scan_ring, operation_t::scan_t);
+    commit(insert_ring, operation_t::insert_t);
+    commit(remove_ring, operation_t::remove_t);
+    loaded_rounds++;
     return true;
 }
 
-operation_t batch_ready(int execute_batch_size) {
-    int scan_execute_batch_size = execute_batch_size / 100;
-    for (int j = 1; j < OPERATION_NR_ITEMS; j++) {
-        if (op_count[j] >= execute_batch_size && op_count[j] > 0) {
-            return (operation_t)j;
-        }
-    }
-    if (op_count[operation_t::scan_t] >= scan_execute_batch_size && op_count[operation_t::scan_t] > 0) {
-        return operation_t::scan_t;
-    }
-    return operation_t::empty_t;
+bool finished() {
+    return loaded_rounds.load() >= rounds;
 }
 
-int scan_start = 0;
+bool adaptive_batch = false;
+const int MAX_BATCH_GROWTH = 16;  // adaptive batches grow up to 16x
+int64_t target_batch_latency_us = 0;  // 0: no latency target
+int64_t target_throughput = 0;  // ops per second, 0: no throughput target
+
+// Online choice of the execute batch size. Every ADAPT_WINDOW batches it
+// scales the size by target / measured batch latency, or by target /
+// measured throughput, whichever target is set. Without a target it follows
+// the epochs' time split: while the DPUs take longer than sending and
+// receiving, larger batches put more work into each launch, so the size
+// grows; once transfers dominate it shrinks.
+class batch_size_controller {
+    const int ADAPT_WINDOW = 8;
+    const double STEP = 1.25;
+    mutex mu;
+    atomic<int> size;
+    int min_size, max_size;
+    int batches;
+    int64_t window_ops, window_batch_ns, window_start;
+    int64_t last_epochs, last_send, last_dpu, last_receive;
 
-void run_batch(operation_t op_type, unique_lock<mutex>& mut, int tid) {
-    int count = op_count[(int)op_type];
-    if(op_type != operation_t::scan_t)
-        op_count[(int)op_type] = 0;
+   public:
+    void init(int initial, int _min_size, int _max_size) {
+        min_size = max(_min_size, 1);
+        max_size = max(_max_size, min_size);
+        size = min(max(initial, min_size), max_size);
+        batches = 0;
+        window_ops = window_batch_ns = 0;
+        window_start = epoch_clock_ns();
+        last_epochs = epoch_times.epochs;
+        last_send = epoch_times.send;
+        last_dpu = epoch_times.dpu;
+        last_receive = epoch_times.receive;
+    }
 
-    switch (op_type) {
-        case operation_t::get_t: {
-            core::get(parlay::make_slice(get_ops, get_ops + count), mut, tid);
-            break;
-        }
-        case operation_t::update_t: {
-            assert(false);
-            break;
-        }
-        case operation_t::predecessor_t: {
-            core::predecessor(
-                parlay::make_slice(predecessor_ops, predecessor_ops + count),
-                mut, tid);
-            break;
-        }
-        case operation_t::scan_t: {
-            int scan_batch = 10000;
-            if (count - scan_start >= scan_batch) {
-                core::scan(parlay::make_slice(scan_ops + scan_start, scan_ops + scan_start + scan_batch), mut, tid);
-                scan_start += scan_batch;
-            } else if(count - scan_start > 1) {
-                parlay::parallel_for(0, count - scan_start, [&](size_t i) {
-                    scan_ops[i] = scan_ops[i + scan_start];
-                });
-                op_count[(int)op_type] = count - scan_start;
-                scan_start = 0;
-                core::scan(parlay::make_slice(scan_ops, scan_ops + op_count[(int)op_type]), mut, tid);
-                op_count[(int)op_type] = 0;
-            }
-            else {
-                op_count[(int)op_type] = 0;
-                scan_start = 0;
-                mut.unlock();
-            }
-            break;
-        }
-        case operation_t::insert_t: {
-            core::insert(parlay::make_slice(insert_ops, insert_ops + count), mut, tid);
-            break;
-        }
-        case operation_t::remove_t: {
-            core::remove(parlay::make_slice(remove_ops, remove_ops + count), mut, tid);
-            break;
+    int get() { return size.load(); }
+
+    // one batch of ops operations took batch_ns, from loading to the end
+    void report(int64_t ops, int64_t batch_ns) {
+        unique_lock lock(mu);
+        batches++;
+        window_ops += ops;
+        window_batch_ns += batch_ns;
+        if (batches < ADAPT_WINDOW) {
+            return;
         }
-        default: {
-            assert(false);
-            break;
+        int64_t now = epoch_clock_ns();
+        double throughput = window_ops * 1e9 / max<int64_t>(now - window_start, 1);
+        double latency_us = window_batch_ns / 1e3 / batches;
+
+        int64_t epochs = epoch_times.epochs - last_epochs;
+        auto ms = [&](atomic<int64_t>& total, int64_t& last) {
+            double ret = (total.load() - last) / 1e6 / max<int64_t>(epochs, 1);
+            last = total.load();
+            return ret;
+        };
+        double send_ms = ms(epoch_times.send, last_send);
+        double dpu_ms = ms(epoch_times.dpu, last_dpu);
+        double receive_ms = ms(epoch_times.receive, last_receive);
+        last_epochs = epoch_times.epochs;
+
+        int old_size = size.load();
+        double scale;
+        if (target_batch_latency_us > 0) {
+            scale = target_batch_latency_us / max(latency_us, 1.0);
+        } else if (target_throughput > 0) {
+            scale = target_throughput / max(throughput, 1.0);
+        } else if (epochs == 0) {
+            scale = 1.0;
+        } else {
+            scale = (dpu_ms > send_ms + receive_ms) ? STEP : 1.0 / STEP;
         }
+        size = min(max((int)(old_size * min(max(scale, 0.5), 2.0)), min_size),
+                   max_size);
+        printf("adaptive batch: %d -> %d tput=%.0f/s latency=%.0fus "
+               "epoch(ms) send=%.3f dpu=%.3f receive=%.3f\n",
+               old_size, size.load(), throughput, latency_us, send_ms, dpu_ms,
+               receive_ms);
+
+        batches = 0;
+        window_ops = window_batch_ns = 0;
+        window_start = now;
     }
-}
+};
 
-bool finished() {
-    if (T < rounds) {
-        return false;
-    }
-    return true;
-}
+batch_size_controller batch_controller;
 
-void execute(parlay::slice<operation*, operation*> ops, int load_batch_size,
-             int execute_batch_size, int threads) {
-    printf("execute n=%lu batchsize=%d,%d\n", ops.size(), load_batch_size,
+template <typename Source>
+void execute(Source&& ops, int load_batch_size, int execute_batch_size,
+             int threads) {
+    printf("execute n=%lu batchsize=%d,%d\n", (size_t)ops.size(), load_batch_size,
            execute_batch_size);
     ASSERT(threads <= num_top_level_threads);
-    memset(op_count, 0, sizeof(op_count));
-    init(ops, load_batch_size, execute_batch_size);
+    int max_batch_size =
+        adaptive_batch ? execute_batch_size * MAX_BATCH_GROWTH
+                       : execute_batch_size;
+    init(ops.size(), load_batch_size, execute_batch_size, max_batch_size,
+         threads);
+    batch_controller.init(execute_batch_size, execute_batch_size / 64,
+                          max_batch_size);
     atomic<int> num_finished_threads = 0;
     parlay::parallel_for(
         0, threads,
@@ -575,28 +788,34 @@ void execute(parlay::slice<operation*, operation*> ops, int load_batch_size,
             pim_coverage_timer->start();
             pim_coverage_timer->end();
             time_nested("global_exec", [&]() {
-                printf("%d / %d *****!!! start\n", tid, threads);
+                printf("%zu / %d *****!!! start\n", tid, threads);
                 while (true) {
-                    {
-                        unique_lock<mutex> lock(load_batch_mutex);
-                        time_start("load batch");
-                        operation_t op_type = operation_t::empty_t;
-                        while (true) {
-                            op_type = batch_ready(execute_batch_size);
-                            if (op_type != operation_t::empty_t) break;
-                            bool next_batch =
-                                load_one_batch(ops, load_batch_size);
-                            if (!next_batch) {
-                                op_type = batch_ready(1); // finish remaining tasks
-                                break;
-                            }
+                    int64_t batch_start = epoch_clock_ns();
+                    int batch_size = adaptive_batch ? batch_controller.get()
+                                                    : execute_batch_size;
+                    time_start("load batch");
+                    claimed_batch b;
+                    while (true) {
+                        b = claim_batch(batch_size, false);
+                        if (b.type != operation_t::empty_t) break;
+                        if (load_one_batch(ops, tid)) continue;
+                        if (!finished()) {
+                            // other threads are still loading rounds
+                            this_thread::yield();
+                            continue;
                         }
-                        time_end("load batch");
+                        b = claim_batch(batch_size, true);  // finish remaining tasks
+                        break;
+                    }
+                    time_end("load batch");
 
-                        if (op_type == operation_t::empty_t) {
-                            break; // !next_batch
-                        }
-                        run_batch(op_type, lock, tid);  // may unlock here
+                    if (b.type == operation_t::empty_t) {
+                        break;
+                    }
+                    run_batch(b, tid);
+                    if (adaptive_batch && b.type != operation_t::scan_t) {
+                        batch_controller.report(
+                            b.len, epoch_clock_ns() - batch_start);
                     }
                 }
                 cout << tid << "*****!!! finished" << endl;
@@ -617,7 +836,108 @@ void execute(parlay::slice<operation*, operation*> ops, int load_batch_size,
         1);
     printf("execute finish!\n");
     fflush(stdout);
-    cout << oracle.inserted.size() << endl;
+    verifier.drain();
+    cout << verifier.oracle_size << endl;
+}
+
+// Threads claim batch_size chunks of a mapped column and hand them to
+// core as the batch, with no copy.
+template <typename T, typename Run>
+void replay_segment(T* data, int64_t len, int batch_size, int threads,
+                    Run run) {
+    atomic<int64_t> next = 0;
+    parlay::parallel_for(
+        0, threads,
+        [&](size_t tid) {
+            while (true) {
+                int64_t l = next.fetch_add(batch_size);
+                if (l >= len) break;
+                int64_t r = min(l + batch_size, len);
+                mutex batch_mutex;
+                unique_lock<mutex> lock(batch_mutex);
+                run(parlay::make_slice(data + l, data + r), lock, tid);
+            }
+        },
+        1);
+}
+
+// Executes a file segment by segment: raw segments straight from the
+// mapping, the rest through the loader. Each segment finishes before the
+// next one starts.
+void replay(op_file_reader& reader, int load_batch_size,
+            int execute_batch_size, int threads) {
+    printf("replay n=%ld segments=%lu\n", reader.size(),
+           reader.segments.size());
+    if (num_thread_batches < threads) {
+        thread_batches = make_unique<operation_batch[]>(threads);
+        num_thread_batches = threads;
+    }
+    int scan_batch_size = min(max(execute_batch_size / 100, 1), SCAN_BATCH);
+    for (auto& seg : reader.segments) {
+        if (seg.raw_offset < 0) {
+            execute(op_file_range{&reader, seg.first, seg.first + seg.count},
+                    load_batch_size, execute_batch_size, threads);
+            continue;
+        }
+        reader.will_need(seg);
+        uint8_t* data = reader.base + seg.raw_offset;
+        // the raw structs of get / predecessor / remove are bare keys, and
+        // those of insert are key-value pairs
+        switch (seg.type) {
+            case operation_t::get_t: {
+                replay_segment((int64_t*)data, seg.count, execute_batch_size,
+                               threads, [](auto keys, auto& lock, int tid) {
+                                   core::get(keys, lock, tid);
+                               });
+                break;
+            }
+            case operation_t::predecessor_t: {
+                replay_segment((int64_t*)data, seg.count, execute_batch_size,
+                               threads, [](auto keys, auto& lock, int tid) {
+                                   core::predecessor(keys, lock, tid);
+                               });
+                break;
+            }
+            case operation_t::scan_t: {
+                // scan fixes up ranges in place, so it gets a private copy
+                replay_segment(
+                    (scan_operation*)data, seg.count, scan_batch_size,
+                    threads, [](auto ops, auto& lock, int tid) {
+                        operation_batch& batch = thread_batches[tid];
+                        batch.clear();
+                        batch.scans = batch.column<scan_operation>(ops.size());
+                        parlay::copy(ops, batch.scans);
+                        core::scan(batch.scans, lock, tid);
+                    });
+                break;
+            }
+            case operation_t::insert_t: {
+                replay_segment((key_value*)data, seg.count,
+                               execute_batch_size, threads,
+                               [](auto kvs, auto& lock, int tid) {
+                                   core::insert(kvs, lock, tid);
+                               });
+                break;
+            }
+            case operation_t::remove_t: {
+                replay_segment((int64_t*)data, seg.count, execute_batch_size,
+                               threads, [](auto keys, auto& lock, int tid) {
+                                   core::remove(keys, lock, tid);
+                               });
+                break;
+            }
+            default: {
+                // no raw path (update): decode through the loader, like the
+                // segments that are not raw
+                execute(op_file_range{&reader, seg.first,
+                                      seg.first + seg.count},
+                        load_batch_size, execute_batch_size, threads);
+                break;
+            }
+        }
+    }
+    printf("replay finish!\n");
+    fflush(stdout);
 }
 
 };  // namespace core
@@ -626,6 +946,9 @@ class frontend {
    public:
     virtual sequence<operation> init_tasks() = 0;
     virtual sequence<operation> test_tasks() = 0;
+    // a file to execute from without materializing it, if any
+    virtual op_file_reader* init_stream() { return nullptr; }
+    virtual op_file_reader* test_stream() { return nullptr; }
 };
 
 class frontend_by_file : public frontend {
@@ -635,6 +958,8 @@ class frontend_by_file : public frontend {
     int init_n;
     int test_n;
 
+    unique_ptr<op_file_reader> init_reader, test_reader;
+
     frontend_by_file(string _if, string _tf, int _in = -1, int _tn = -1) {
         init_file = _if;
         test_file = _tf;
@@ -642,7 +967,23 @@ class frontend_by_file : public frontend {
         test_n = _tn;
     }
 
+    op_file_reader* init_stream() {
+        if (!is_op_file(init_file)) return nullptr;
+        init_reader = make_unique<op_file_reader>(init_file, init_n);
+        return init_reader.get();
+    }
+
+    op_file_reader* test_stream() {
+        if (!is_op_file(test_file)) return nullptr;
+        test_reader = make_unique<op_file_reader>(test_file, test_n);
+        return test_reader.get();
+    }
+
     sequence<operation> init_tasks() {
+        if (is_op_file(init_file)) {
+            op_file_reader reader(init_file, init_n);
+            return reader.cut(0, reader.size());
+        }
         auto ops = read_op_file(init_file, [&](const operation& op) {
             assert(op.type == insert_t);
         });
@@ -654,6 +995,10 @@ class frontend_by_file : public frontend {
     }
 
     sequence<operation> test_tasks() {
+        if (is_op_file(test_file)) {
+            op_file_reader reader(test_file, test_n);
+            return reader.cut(0, reader.size());
+        }
         auto ops = read_op_file(test_file, [&](const operation& op) {
             assert(op.type != empty_t);
         });
@@ -715,6 +1060,7 @@ class frontend_testgen {
     string init_file;
     string test_file;
     batch_parallel_oracle oracle;
+    sequence<int64_t> init_keys;  // in insertion order
     int execute_batch_size;
 
     frontend_testgen(int _init_n, int _test_n, sequence<double> _pos, int _bias,
@@ -742,6 +1088,9 @@ class frontend_testgen {
     }
 
     void init_oracle(slice<operation*, operation*> ops) {
+        init_keys = parlay::map(ops, [](const operation& op) {
+            return op.tsk.i.key;
+        });
         auto kvs = parlay::delayed_seq<key_value>(ops.size(), [&](size_t i) {
             return (key_value){.key = ops[i].tsk.i.key,
                                .value = ops[i].tsk.i.value};
@@ -771,6 +1120,20 @@ class frontend_testgen {
         }
     }
 
+    sequence<operation> generate_ycsb(char w, ycsb::distribution_t dist,
+                                      int n) {
+        auto wl = ycsb::core_workload(w);
+        wl.dist = dist;
+        printf("ycsb %c: %s, n=%d\n", w, ycsb::distribution_name[dist], n);
+        return ycsb::generate(wl, make_slice(init_keys), n);
+    }
+
+    void write_ycsb_file(char w, ycsb::distribution_t dist) {
+        write_init_file(this->init_file);
+        auto test_ops = generate_ycsb(w, dist, test_n);
+        write_ops_to_file(test_file, make_slice(test_ops));
+    }
+
     void generate_microbenchmark_one_type(int t) {
         if (t == operation_t::update_t) return;
         auto pos = sequence<double>(OPERATION_NR_ITEMS, 0);
@@ -811,104 +1174,20 @@ class frontend_testgen {
             }
         };
 
-        // YCSB A = 50% predecessor : 50% insert
-        for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
-            auto pos = sequence<double>(OPERATION_NR_ITEMS, 0);
-            pos[operation_t::predecessor_t] = 1.0;
-            auto ops = generate_tasks(pos, test_n, true, alpha, 1.0);
-            ASSERT(ops.size() == 1e8);
-            for (int i = 0; i < ops.size(); i ++) {
-                operation original_task = ops[i];
-                if (rand() % 2 == 0) {
-                    operation switched_task;
-                    switched_task.type = operation_t::insert_t;
-                    switched_task.tsk.i = (insert_operation){.key = original_task.tsk.p.key};
-                    ops[i] = switched_task;
-                }
-            }
-            char filename[500];
-            sprintf(filename, "test_%d_%.1f_ycsb_a.binary", test_n, alpha);
-            typechecker(ops);
-            write_ops_to_file(string(filename), make_slice(ops));
-            cout << filename << endl;
-        }
-
-        // YCSB B = 95% predecessor : 5% insert
-        for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
-            auto pos = sequence<double>(OPERATION_NR_ITEMS, 0);
-            pos[operation_t::predecessor_t] = 1.0;
-            auto ops = generate_tasks(pos, test_n, true, alpha, 1.0);
-            ASSERT(ops.size() == 1e8);
-            for (int i = 0; i < ops.size(); i ++) {
-                operation original_task = ops[i];
-                if (rand() % 20 == 0) {
-                    operation switched_task;
-                    switched_task.type = operation_t::insert_t;
-                    switched_task.tsk.i = (insert_operation){.key = original_task.tsk.p.key};
-                    ops[i] = switched_task;
-                }
-            }
-            char filename[500];
-            sprintf(filename, "test_%d_%.1f_ycsb_b.binary", test_n, alpha);
-            typechecker(ops);
-            write_ops_to_file(string(filename), make_slice(ops));
-            cout << filename << endl;
-        }
-
-        // YCSB C = micro predecessor
-        for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
-            char filename[500];
-            sprintf(filename, "test_%d_%.1f_ycsb_c.binary", test_n, alpha);
-            string targetname(filename);
-            sprintf(filename, "test_%d_%.1f_%d.binary", test_n, alpha, predecessor_t);
-            string sourcename(filename);
-            {
-                struct stat statbuf;
-                assert(stat(sourcename.c_str(), &statbuf) == 0);
-                // otherwise source file doesn't exist
-            }
-            string cmd = "cp '" + sourcename + "' '" + targetname + "'";
-            cout<<targetname<<endl;
-            system(cmd.c_str());
-        }
-
-        // YCSB D = micro insert
-        for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
-            char filename[500];
-            sprintf(filename, "test_%d_%.1f_ycsb_d.binary", test_n, alpha);
-            string targetname(filename);
-            sprintf(filename, "test_%d_%.1f_%d.binary", test_n, alpha, insert_t);
-            string sourcename(filename);
-            {
-                struct stat statbuf;
-                assert(stat(sourcename.c_str(), &statbuf) == 0);
-                // otherwise source file doesn't exist
-            }
-            string cmd = "cp '" + sourcename + "' '" + targetname + "'";
-            cout<<targetname<<endl;
-            system(cmd.c_str());
-        }
-
-        // YCSB E = 95% scan : 5% insert
-        for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
-            auto pos = sequence<double>(OPERATION_NR_ITEMS, 0);
-            pos[operation_t::scan_t] = 1.0;
-            auto ops = generate_tasks(pos, test_n / 100, true, alpha, 1.0);
-            ASSERT(ops.size() == 1e8);
-            for (int i = 0; i < ops.size(); i ++) {
-                operation original_task = ops[i];
-                if (rand() % 20 == 0) {
-                    operation switched_task;
-                    switched_task.type = operation_t::insert_t;
-                    switched_task.tsk.i = (insert_operation){.key = original_task.tsk.s.lkey};
-                    ops[i] = switched_task;
-                }
+        // alpha 0.0 is uniform, 1.0 the workload's own request distribution
+        for (char w = 'a'; w <= 'f'; w++) {
+            auto wl = ycsb::core_workload(w);
+            // scans touch up to max_scan_length records each
+            int n = (w == 'e') ? test_n / ycsb::config().max_scan_length : test_n;
+            for (double alpha = 0.0; alpha < 1.1; alpha += 1.0) {
+                auto dist = (alpha == 0.0) ? ycsb::uniform_d : wl.dist;
+                auto ops = generate_ycsb(w, dist, n);
+                char filename[500];
+                sprintf(filename, "test_%d_%.1f_ycsb_%c.binary", test_n, alpha, w);
+                typechecker(ops);
+                write_ops_to_file(string(filename), make_slice(ops));
+                cout << filename << endl;
             }
-            char filename[500];
-            sprintf(filename, "test_%d_%.1f_ycsb_e.binary", test_n, alpha);
-            typechecker(ops);
-            write_ops_to_file(string(filename), make_slice(ops));
-            cout << filename << endl;
         }
     }
 
@@ -947,6 +1226,17 @@ class frontend_testgen {
     }
 };
 
+// open loop latency benchmark, defined in open_loop.hpp
+struct open_loop_config {
+    bool active = false;
+    double arrival_rate;  // operations per second
+    int64_t batch_window_us;
+    int clients;
+    int64_t queue_capacity;  // per operation type
+};
+open_loop_config open_loop_conf;
+void run_open_loop(frontend& f, int execute_batch_size);
+
 class driver {
    public:
     static argparse::ArgumentParser parser() {
@@ -1041,6 +1331,72 @@ class driver {
             .help("init state")
             .default_value(false)
             .implicit_value(true);
+        program.add_argument("--adaptive_batch")
+            .help("tune the execute batch size online, starting from the given batch sizes")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--target_batch_latency_us")
+            .help("--target_batch_latency_us [us] (adaptive batch; 0: no latency target)")
+            .default_value(0)
+            .scan<'i', int>();
+        program.add_argument("--target_throughput")
+            .help("--target_throughput [ops/s] (adaptive batch without a latency target; 0: follow the epoch time split)")
+            .default_value(0)
+            .scan<'i', int>();
+        program.add_argument("--open_loop")
+            .help("measure per operation latency under Poisson arrivals")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--arrival_rate")
+            .help("--arrival_rate [operations per second] (open loop)")
+            .default_value(1e6)
+            .scan<'g', double>();
+        program.add_argument("--batch_window_us")
+            .help("--batch_window_us [max microseconds an operation waits for its batch] (open loop)")
+            .default_value(1000)
+            .scan<'i', int>();
+        program.add_argument("--clients")
+            .help("--clients [#submitting threads] (open loop)")
+            .default_value(4)
+            .scan<'i', int>();
+        program.add_argument("--queue_capacity")
+            .help("--queue_capacity [pending operations per type] (open loop)")
+            .default_value(1 << 16)
+            .scan<'i', int>();
+        program.add_argument("--columnar")
+            .help("write generated operation files in the columnar format")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--raw_blocks")
+            .help("columnar files: store single type blocks raw, to be replayed without copies")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--ycsb")
+            .help("with -o: write YCSB core workload [a-f] instead of the -g/-u/... mix")
+            .default_value(string(""));
+        program.add_argument("--ycsb_distribution")
+            .help("--ycsb_distribution [uniform|zipfian|scrambled|latest|hotspot], default: the workload's own")
+            .default_value(string(""));
+        program.add_argument("--async_verify")
+            .help("check results on a background thread, off the critical path")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--verify_sample")
+            .help("--verify_sample [fraction of reads to check]")
+            .default_value(1.0)
+            .scan<'g', double>();
+        program.add_argument("--verify_queue")
+            .help("--verify_queue [batches queued for the verifier before producers block]")
+            .default_value(16)
+            .scan<'i', int>();
+        program.add_argument("--seed")
+            .help("--seed [seed of the generated workload, -1 for time based]")
+            .default_value(-1)
+            .scan<'i', int>();
+        program.add_argument("--io_buffers")
+            .help("--io_buffers [#transfer buffers kept for reuse by io managers]")
+            .default_value(NUM_IO_MANAGERS)
+            .scan<'i', int>();
 
         return program;
     }
@@ -1053,57 +1409,80 @@ class driver {
     static void run(frontend& f, int init_batch_size, int test_batch_size) {
         pim_skip_list_drivers = new pim_skip_list[core::num_top_level_threads];
         pim_skip_list_drivers[0].init();
-        
-        {
-            auto init_ops = f.init_tasks();
-            cpu_coverage_timer->reset();
-            pim_coverage_timer->reset();
-            core::execute(make_slice(init_ops), init_batch_size,
-                          init_batch_size, 1);
-        }
-        total_communication = 0;
-        total_actual_communication = 0;
+        core::verifier.serve([&]() {
+            if (op_file_reader* stream = f.init_stream()) {
+                cpu_coverage_timer->reset();
+                pim_coverage_timer->reset();
+                if (stream->has_raw_segments()) {
+                    core::replay(*stream, init_batch_size, init_batch_size, 1);
+                } else {
+                    core::execute(*stream, init_batch_size, init_batch_size, 1);
+                }
+            } else {
+                auto init_ops = f.init_tasks();
+                cpu_coverage_timer->reset();
+                pim_coverage_timer->reset();
+                core::execute(make_slice(init_ops), init_batch_size,
+                              init_batch_size, 1);
+            }
+            total_communication = 0;
+            total_actual_communication = 0;
 
-        for (int i = 0; i < core::num_top_level_threads; i ++) {
-            pim_skip_list_drivers[i].push_pull_limit_dynamic = core::push_pull_limit_dynamic;
-        }
+            for (int i = 0; i < core::num_top_level_threads; i ++) {
+                pim_skip_list_drivers[i].push_pull_limit_dynamic = core::push_pull_limit_dynamic;
+            }
 
-        dpu_energy_stats(false);
-        reset_all_timers();
-        {
-            auto test_ops = f.test_tasks();
-            cpu_coverage_timer->reset();
-            pim_coverage_timer->reset();
+            dpu_energy_stats(false);
+            reset_all_timers();
+            if (open_loop_conf.active) {
+                run_open_loop(f, test_batch_size);
+            } else {
+                op_file_reader* stream = f.test_stream();
+                sequence<operation> test_ops;
+                if (stream == nullptr) {
+                    test_ops = f.test_tasks();
+                }
+                cpu_coverage_timer->reset();
+                pim_coverage_timer->reset();
 
 #ifdef USE_PAPI
-            papi_init_program(parlay::num_workers());
-            papi_reset_counters();
-            papi_turn_counters(true);
-            papi_check_counters(parlay::worker_id());
-            papi_wait_counters(true, parlay::num_workers());
+                papi_init_program(parlay::num_workers());
+                papi_reset_counters();
+                papi_turn_counters(true);
+                papi_check_counters(parlay::worker_id());
+                papi_wait_counters(true, parlay::num_workers());
 #endif
 
-            core::execute(make_slice(test_ops), test_batch_size,
-                          test_batch_size, core::num_top_level_threads);
+                if (stream != nullptr && stream->has_raw_segments()) {
+                    core::replay(*stream, test_batch_size, test_batch_size,
+                                 core::num_top_level_threads);
+                } else if (stream != nullptr) {
+                    core::execute(*stream, test_batch_size, test_batch_size,
+                                  core::num_top_level_threads);
+                } else {
+                    core::execute(make_slice(test_ops), test_batch_size,
+                                  test_batch_size, core::num_top_level_threads);
+                }
 
 #ifdef USE_PAPI
-            papi_turn_counters(false);
-            papi_check_counters(parlay::worker_id());
-            papi_wait_counters(false, parlay::num_workers());
+                papi_turn_counters(false);
+                papi_check_counters(parlay::worker_id());
+                papi_wait_counters(false, parlay::num_workers());
 #endif
 
-            print_all_timers(print_type::pt_full);
-            print_all_timers(print_type::pt_name);
-            print_all_timers(print_type::pt_time);
-            print_all_timers_average();
-            cpu_coverage_timer->print(pt_full);
-            pim_coverage_timer->print(pt_full);
+                print_all_timers(print_type::pt_full);
+                print_all_timers(print_type::pt_name);
+                print_all_timers(print_type::pt_time);
+                print_all_timers_average();
+                cpu_coverage_timer->print(pt_full);
+                pim_coverage_timer->print(pt_full);
 
 #ifdef USE_PAPI
-            papi_print_counters(1);
+                papi_print_counters(1);
 #endif
-        }
-
+            }
+        });
+        core::verifier.report();
         dpu_energy_stats(false);
         delete[] pim_skip_list_drivers;
     }
@@ -1119,6 +1498,21 @@ class driver {
             std::exit(1);
         }
 
+        string ycsb_workload = program.get<string>("--ycsb");
+        string ycsb_distribution = program.get<string>("--ycsb_distribution");
+        if ((ycsb_workload.size() > 0 &&
+             !ycsb::is_core_workload(ycsb_workload)) ||
+            (ycsb_distribution.size() > 0 &&
+             !ycsb::is_distribution(ycsb_distribution))) {
+            std::cerr << "unknown YCSB workload or distribution" << std::endl;
+            std::cerr << program;
+            std::exit(1);
+        }
+
+        if (int seed = program.get<int>("--seed"); seed >= 0) {
+            rn_gen::init(seed);
+        }
+
         parlay::sequence<double> pos(OPERATION_NR_ITEMS, 0.0);
         pos[1] = program.get<double>("-g");
         pos[2] = program.get<double>("-u");
@@ -1127,6 +1521,9 @@ class driver {
         pos[5] = program.get<double>("-i");
         pos[6] = program.get<double>("-r");
         core::check_result = (program["--nocheck"] == false);
+        core::verifier.async = (program["--async_verify"] == true);
+        core::verifier.sample_rate = program.get<double>("--verify_sample");
+        core::verifier.capacity = program.get<int>("--verify_queue");
         timer::print_when_time = (program["--noprint"] == false);
         timer::default_detail = (program["--nodetail"] == false);
         int bias = program.get<int>("--bias");
@@ -1135,6 +1532,23 @@ class driver {
         core::num_top_level_threads = program.get<int>("--top_level_threads");
 
         core::num_wait_microsecond = program.get<int>("--wait_microsecond");
+        if (program.get<int>("--io_buffers") < 1) {
+            std::cerr << "--io_buffers must be at least 1" << std::endl;
+            std::cerr << program;
+            std::exit(1);
+        }
+        transfer_buffers.set_capacity(program.get<int>("--io_buffers"));
+        core::adaptive_batch = (program["--adaptive_batch"] == true);
+        core::target_batch_latency_us =
+            program.get<int>("--target_batch_latency_us");
+        core::target_throughput = program.get<int>("--target_throughput");
+        open_loop_conf.active = (program["--open_loop"] == true);
+        open_loop_conf.arrival_rate = program.get<double>("--arrival_rate");
+        open_loop_conf.batch_window_us = program.get<int>("--batch_window_us");
+        open_loop_conf.clients = program.get<int>("--clients");
+        open_loop_conf.queue_capacity = program.get<int>("--queue_capacity");
+        op_file_columnar = (program["--columnar"] == true);
+        op_file_raw_blocks = (program["--raw_blocks"] == true);
         ASSERT(core::num_top_level_threads >= 1);
         ASSERT(core::num_wait_microsecond >= 0);
         cout << "thread: " << core::num_top_level_threads << endl;
@@ -1180,7 +1594,15 @@ class driver {
             frontend_testgen frontend(init_n, test_n, move(pos), bias,
                                       output_file[0], output_file[1],
                                       output_batch_size);
-            frontend.write_file();
+            if (ycsb_workload.size() > 0) {
+                char w = ycsb_workload[0];
+                frontend.write_ycsb_file(
+                    w, ycsb_distribution.size() > 0
+                           ? ycsb::parse_distribution(ycsb_distribution)
+                           : ycsb::core_workload(w).dist);
+            } else {
+                frontend.write_file();
+            }
         } else {  // in memory test
             printf("Test with generated data:\n");
             for (int i = 1; i < OPERATION_NR_ITEMS; i++) {
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <parlay/parallel.h>
+#include "task_framework_host.hpp"
+
+using namespace std;
+
+// Multi-round batches as coroutines. A batch co_awaits an epoch with a fill
+// function that allocates and pushes its blocks into the IO_Manager; the
+// scheduler packs the fills of independent batches into shared epochs, and
+// resumes each batch once the epoch has been executed, with the replies
+// readable until the batch suspends again or returns. co_await yields
+// whether the epoch succeeded.
+//
+//   epoch_coroutine::batch_task lookup(epoch_coroutine::scheduler& s) {
+//       IO_Task_Batch* b;
+//       bool ok = co_await s.epoch(1, [&](IO_Manager* io) {
+//           b = io->alloc<fixed_task, fixed_reply>(direct);
+//           ... push tasks ...
+//           io->finish_task_batch();
+//       });
+//       ... read b->ith(...), maybe co_await the next round ...
+//   }
+namespace epoch_coroutine {
+
+struct batch_task {
+    struct promise_type {
+        batch_task get_return_object() {
+            return batch_task{
+                coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    coroutine_handle<promise_type> handle;
+};
+
+struct epoch_request {
+    int blocks;      // IO blocks the fill allocates
+    bool exclusive;  // needs an epoch of its own (e.g. broadcast blocks)
+    function<void(IO_Manager*)> fill;
+    coroutine_handle<> handle;
+    bool ok;
+};
+
+class scheduler {
+    mutex waiting_mutex;
+    vector<epoch_request*> waiting;
+    vector<coroutine_handle<batch_task::promise_type>> tasks;
+
+    void enqueue(epoch_request* r) {
+        unique_lock lock(waiting_mutex);
+        waiting.push_back(r);
+    }
+
+    // The longest waiting requests that fit in one epoch. Shared epochs
+    // only hold direct blocks, which IO_Manager::sync accepts in any order.
+    vector<epoch_request*> take_group() {
+        unique_lock lock(waiting_mutex);
+        vector<epoch_request*> group;
+        int blocks = 0;
+        size_t i = 0;
+        for (; i < waiting.size(); i++) {
+            epoch_request* r = waiting[i];
+            ASSERT(r->blocks >= 1 && r->blocks <= MAX_IO_BLOCKS);
+            if (r->exclusive) {
+                if (group.empty()) {
+                    group.push_back(r);
+                    i++;
+                }
+                break;
+            }
+            if (blocks + r->blocks > MAX_IO_BLOCKS) {
+                break;
+            }
+            blocks += r->blocks;
+            group.push_back(r);
+        }
+        waiting.erase(waiting.begin(), waiting.begin() + i);
+        return group;
+    }
+
+    IO_Manager* launch(const vector<epoch_request*>& group) {
+        if (group.empty()) {
+            return nullptr;
+        }
+        IO_Manager* io = alloc_io_manager();
+        io->init();
+        for (epoch_request* r : group) {
+            r->fill(io);
+        }
+        bool ok = io->exec();
+        for (epoch_request* r : group) {
+            r->ok = ok;
+        }
+        return io;
+    }
+
+    void resume(const vector<epoch_request*>& group) {
+        parlay::parallel_for(
+            0, group.size(), [&](size_t i) { group[i]->handle.resume(); },
+            1);
+    }
+
+   public:
+    struct epoch_awaiter : epoch_request {
+        scheduler* s;
+        bool await_ready() { return false; }
+        void await_suspend(coroutine_handle<> h) {
+            handle = h;
+            s->enqueue(this);
+        }
+        bool await_resume() { return ok; }
+    };
+
+    template <typename Fill>
+    epoch_awaiter epoch(int blocks, Fill fill, bool exclusive = false) {
+        epoch_awaiter a;
+        a.blocks = blocks;
+        a.exclusive = exclusive;
+        a.fill = fill;
+        a.s = this;
+        return a;
+    }
+
+    void spawn(batch_task t) { tasks.push_back(t.handle); }
+
+    // Runs all spawned batches to completion. While the batches of one
+    // epoch process their replies, the next epoch (made of batches that
+    // were already waiting) is filled and executed.
+    void run() {
+        resume_all_new();
+        auto cur = take_group();
+        IO_Manager* io_cur = launch(cur);
+        while (!cur.empty()) {
+            auto next = take_group();
+            IO_Manager* io_next = nullptr;
+            parlay::par_do(
+                [&]() {
+                    io_cur->adopt();
+                    resume(cur);
+                    io_cur->reset();
+                },
+                [&]() { io_next = launch(next); });
+            cur = std::move(next);
+            io_cur = io_next;
+            if (cur.empty()) {
+                cur = take_group();
+                io_cur = launch(cur);
+            }
+        }
+        for (auto h : tasks) {
+            ASSERT(h.done());
+            h.destroy();
+        }
+        tasks.clear();
+    }
+
+   private:
+    void resume_all_new() {
+        parlay::parallel_for(
+            0, tasks.size(), [&](size_t i) { tasks[i].resume(); }, 1);
+    }
+};
+
+// One exec_with_continuation batch: every round co_awaits an epoch, so
+// batches spawned on the same scheduler share the epochs of their rounds.
+// rounds is set to the number of rounds, or -1 if an epoch failed.
+template <typename Task, typename Reply, typename TaskType,
+          typename ResumeFunc, typename ConsumeFunc>
+batch_task continuation_batch(scheduler& s, parlay::sequence<TaskType> tasks,
+                              parlay::sequence<int> targets, ResumeFunc resume,
+                              ConsumeFunc consume, int* rounds) {
+    ASSERT(!Reply::fixed);
+    int n = tasks.size();
+    auto active = parlay::tabulate(n, [&](size_t i) { return (int)i; });
+    auto more = parlay::sequence<bool>(n, false);
+    auto tokens = parlay::sequence<int64_t>(n, 0);
+
+    *rounds = 0;
+    while (active.size() > 0) {
+        // a hot DPU's surplus spills into follow-up epochs (see place)
+        parlay::sort_inplace(active, [&](int a, int b) {
+            return make_pair(targets[a], a) < make_pair(targets[b], b);
+        });
+        int m = active.size();
+        auto location = parlay::sequence<int>(m);
+        IO_Task_Batch* batch = nullptr;
+        bool ok = co_await s.epoch(1, [&](IO_Manager* io) {
+            batch = io->alloc<Task, Reply>(direct);
+            batch->push_task_sorted(
+                m, nr_of_dpus, [&](size_t j) { return tasks[active[j]]; },
+                [&](size_t j) { return targets[active[j]]; },
+                make_slice(location));
+            io->finish_task_batch();
+        });
+        if (!ok) {
+            printf("continuation round %d failed\n", *rounds);
+            *rounds = -1;
+            co_return;
+        }
+        parlay::parallel_for(0, m, [&](size_t j) {
+            int i = active[j];
+            int target = targets[i];
+            uint8_t* reply = (uint8_t*)batch->ith(target, location[j]);
+            int length = batch->tbs[target].ith_length(location[j]);
+            ASSERT(length >= CONTINUATION_HEADER);
+            int64_t* header = (int64_t*)reply;
+            more[i] = (header[0] == CONTINUATION_MORE);
+            tokens[i] = header[1];
+            consume((size_t)i, reply + CONTINUATION_HEADER,
+                    length - CONTINUATION_HEADER);
+        });
+        (*rounds)++;
+        active = parlay::filter(active, [&](int i) { return more[i]; });
+        parlay::parallel_for(0, active.size(), [&](size_t j) {
+            int i = active[j];
+            tasks[i] = resume(tasks[i], tokens[i]);
+        });
+    }
+}
+
+};  // namespace epoch_coroutine
+
+// Runs tasks whose variable length replies may exceed what a DPU can return
+// in one epoch. Each reply starts with a continuation header (see
+// task_framework_common.h); while it says CONTINUATION_MORE, the task
+// resume(task, token) is re-issued in the next round. consume(i, payload,
+// length) receives the chunks of task i in order, one round at a time, so
+// concatenating them gives the full reply. Returns the number of rounds,
+// or -1 if an epoch failed.
+template <typename Task, typename Reply, typename TaskFunc, typename IdFunc,
+          typename ResumeFunc, typename ConsumeFunc>
+int exec_with_continuation(int n, TaskFunc taskf, IdFunc g, ResumeFunc resume,
+                           ConsumeFunc consume) {
+    epoch_coroutine::scheduler s;
+    int rounds = 0;
+    s.spawn(epoch_coroutine::continuation_batch<Task, Reply>(
+        s, parlay::tabulate(n, taskf),
+        parlay::tabulate(n, [&](size_t i) { return (int)g(i); }), resume,
+        consume, &rounds));
+    s.run();
+    return rounds;
+}
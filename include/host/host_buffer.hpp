@@ -0,0 +1,192 @@
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <parlay/parallel.h>
+#include "debug.hpp"
+#include "dpu_control.hpp"
+using namespace std;
+
+// Placement of the host side CPU-DPU transfer buffers.
+// Each DPU's buffer is bound to the NUMA node its rank is attached to, backed
+// by huge pages, and faulted in before first use by threads running on
+// that node.
+namespace host_buffer {
+
+const size_t HUGE_PAGE_SIZE = (2ull << 20);
+const int MAX_NUMA_NODES = 64;
+const int MPOL_PREFERRED_MODE = 1;  // MPOL_PREFERRED in <numaif.h>
+
+static inline size_t round_up(size_t x, size_t align) {
+    return (x + align - 1) / align * align;
+}
+
+// -1 if unknown. The UPMEM driver exposes one dpu_rank device per rank.
+static int rank_numa_node(uint32_t rank_index) {
+    const char* patterns[] = {"/sys/class/dpu_rank/dpu_rank%u/numa_node",
+                              "/sys/class/dpu_rank/dpu_rank%u/device/numa_node"};
+    for (const char* pattern : patterns) {
+        char path[128];
+        snprintf(path, sizeof(path), pattern, rank_index);
+        FILE* f = fopen(path, "r");
+        if (f == NULL) {
+            continue;
+        }
+        int node = -1;
+        if (fscanf(f, "%d", &node) != 1) {
+            node = -1;
+        }
+        fclose(f);
+        if (node >= 0 && node < MAX_NUMA_NODES) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+// numa node of each DPU in dpu_set (-1 for unknown / not allocated yet)
+static vector<int> dpu_numa_nodes(int count) {
+    vector<int> nodes(count, -1);
+    if (!dpu_control::active) {
+        return nodes;
+    }
+    int dpu_id = 0;
+    dpu_set_t rank;
+    uint32_t each_rank;
+    DPU_RANK_FOREACH(dpu_set, rank, each_rank) {
+        int node = rank_numa_node(each_rank);
+        uint32_t rank_dpus = 0;
+        DPU_ASSERT(dpu_get_nr_dpus(rank, &rank_dpus));
+        for (uint32_t i = 0; i < rank_dpus && dpu_id < count; i++) {
+            nodes[dpu_id++] = node;
+        }
+    }
+    return nodes;
+}
+
+static bool bind_to_node(uint8_t* start, size_t length, int node) {
+    if (node < 0 || length == 0) {
+        return false;
+    }
+    unsigned long nodemask = 1ul << node;
+    long ret = syscall(SYS_mbind, start, length, MPOL_PREFERRED_MODE,
+                       &nodemask, (unsigned long)MAX_NUMA_NODES + 1, 0);
+    return ret == 0;
+}
+
+// false if the node's cpus are unknown
+static bool node_cpus(int node, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    if (node < 0) {
+        return false;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    // e.g. "0-15,32-47"
+    int l, r;
+    while (fscanf(f, "%d", &l) == 1) {
+        r = l;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &r) != 1) break;
+            c = fgetc(f);
+        }
+        for (int i = l; i <= r && i < CPU_SETSIZE; i++) {
+            CPU_SET(i, cpus);
+        }
+        if (c != ',') break;
+    }
+    fclose(f);
+    return CPU_COUNT(cpus) > 0;
+}
+
+// Zero buffers [l, r) from threads pinned to node, so first touch places
+// the pages there even where mbind did not take. Without the node's cpus
+// the parlay workers touch them, which spreads them over the local nodes.
+static void touch_on_node(uint8_t* base, size_t size_per_dpu, int l, int r,
+                          int node) {
+    auto touch = [&](int i) { memset(base + size_per_dpu * i, 0, size_per_dpu); };
+    cpu_set_t cpus;
+    if (!node_cpus(node, &cpus)) {
+        parlay::parallel_for(l, r, [&](size_t i) { touch(i); }, 1);
+        return;
+    }
+    int k = min(CPU_COUNT(&cpus), r - l);
+    vector<thread> touchers;
+    for (int t = 0; t < k; t++) {
+        touchers.emplace_back([&, t]() {
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            for (int i = l + t; i < r; i += k) {
+                touch(i);
+            }
+        });
+    }
+    for (auto& x : touchers) {
+        x.join();
+    }
+}
+
+static void* map_huge(size_t total) {
+#ifdef MAP_HUGETLB
+    void* p = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+#endif
+    // no reserved hugetlbfs pages: fall back to transparent huge pages
+    void* p2 = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p2 == MAP_FAILED) {
+        perror("host buffer mmap");
+        exit(EXIT_FAILURE);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p2, total, MADV_HUGEPAGE);
+#endif
+    return p2;
+}
+
+// Allocate count consecutive buffers of size_per_dpu bytes.
+static uint8_t* alloc_dpu_buffers(size_t size_per_dpu, int count) {
+    size_t total = round_up(size_per_dpu * count, HUGE_PAGE_SIZE);
+    uint8_t* base = (uint8_t*)map_huge(total);
+
+    vector<int> nodes = dpu_numa_nodes(count);
+    int bound = 0;
+    for (int l = 0; l < count;) {
+        int r = l;
+        while (r < count && nodes[r] == nodes[l]) r++;
+        // a huge page straddling two nodes' ranges follows the left one
+        size_t start = round_up(size_per_dpu * l, HUGE_PAGE_SIZE);
+        size_t end = min(round_up(size_per_dpu * r, HUGE_PAGE_SIZE), total);
+        if (start < end && bind_to_node(base + start, end - start, nodes[l])) {
+            bound += r - l;
+        }
+        touch_on_node(base, size_per_dpu, l, r, nodes[l]);
+        l = r;
+    }
+#ifdef KHB_CPU_DEBUG
+    printf("host buffer: %d / %d DPU buffers bound to their rank's node\n",
+           bound, count);
+#endif
+    return base;
+}
+
+static void free_dpu_buffers(uint8_t* base, size_t size_per_dpu, int count) {
+    munmap(base, round_up(size_per_dpu * count, HUGE_PAGE_SIZE));
+}
+
+};  // namespace host_buffer
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+#include "debug.hpp"
+#include "macro_common.h"
+#include "operation_def.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// Columnar operation file.
+//
+//   op_file_header
+//   for each block of OP_FILE_BLOCK_SIZE operations:
+//     type column   one byte per operation
+//     key column    key - key_base, bit packed at key_bits per operation
+//     value column  one int64 per operation that has one
+//                   (update / insert: value, scan: rkey)
+//   block index     one op_file_block per block, at header.index_offset
+//
+// All sections are 8 byte aligned. The block index carries per block type
+// counts, so a reader can find homogeneous segments without decoding.
+//
+// Version 2 adds raw blocks (key_bits == OP_FILE_RAW): a block of a single
+// type stored as an array of its operation struct (get_operation, ...),
+// without type or value column. Raw blocks are written back to back, so a
+// run of them is one array that can be handed to core as a batch.
+
+const uint64_t OP_FILE_MAGIC = 0x53504f4c4f43ULL;  // "COLOPS"
+const uint32_t OP_FILE_VERSION = 2;
+const int64_t OP_FILE_BLOCK_SIZE = 4096;
+const int32_t OP_FILE_RAW = -1;
+
+struct op_file_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    int64_t n;
+    int64_t num_blocks;
+    int64_t index_offset;
+};
+
+struct op_file_block {
+    int64_t type_offset;
+    int64_t key_offset;
+    int64_t value_offset;
+    int64_t key_base;
+    int32_t key_bits;
+    int32_t count;
+    int64_t type_count[OPERATION_NR_ITEMS];
+};
+
+bool op_file_columnar = false;  // write_ops_to_file writes this format
+bool op_file_raw_blocks = false;  // write single type blocks raw
+
+// size of the operation struct of type t
+inline int64_t op_struct_size(operation_t t) {
+    switch (t) {
+        case operation_t::get_t: return sizeof(get_operation);
+        case operation_t::update_t: return sizeof(update_operation);
+        case operation_t::predecessor_t: return sizeof(predecessor_operation);
+        case operation_t::scan_t: return sizeof(scan_operation);
+        case operation_t::insert_t: return sizeof(insert_operation);
+        case operation_t::remove_t: return sizeof(remove_operation);
+        default: return 0;
+    }
+}
+
+// the type of a block holding one type only, empty_t otherwise
+inline operation_t block_type(const op_file_block& blk) {
+    for (int t = 1; t < OPERATION_NR_ITEMS; t++) {
+        if (blk.type_count[t] == blk.count) return (operation_t)t;
+    }
+    return operation_t::empty_t;
+}
+
+inline int64_t op_key(const operation& op) {
+    return (op.type == operation_t::scan_t) ? op.tsk.s.lkey : op.tsk.g.key;
+}
+
+inline bool op_has_value(operation_t t) {
+    return t == operation_t::update_t || t == operation_t::insert_t ||
+           t == operation_t::scan_t;
+}
+
+inline int64_t op_value(const operation& op) {
+    return (op.type == operation_t::scan_t) ? op.tsk.s.rkey : op.tsk.u.value;
+}
+
+inline operation make_op(operation_t t, int64_t key, int64_t value) {
+    operation op;
+    op.type = t;
+    switch (t) {
+        case operation_t::scan_t: {
+            op.tsk.s = (scan_operation){.lkey = key, .rkey = value};
+            break;
+        }
+        case operation_t::update_t: {
+            op.tsk.u = (update_operation){.key = key, .value = value};
+            break;
+        }
+        case operation_t::insert_t: {
+            op.tsk.i = (insert_operation){.key = key, .value = value};
+            break;
+        }
+        default: {
+            op.tsk.i = (insert_operation){.key = key, .value = 0};
+            break;
+        }
+    }
+    return op;
+}
+
+inline int64_t op_file_align(int64_t x) { return (x + 7) & ~(int64_t)7; }
+
+inline int64_t packed_words(int64_t count, int bits) {
+    return (count * bits + 63) / 64 + 1;  // one spare word for unaligned reads
+}
+
+inline uint64_t unpack_bits(const uint64_t* words, int64_t i, int bits) {
+    if (bits == 0) return 0;
+    int64_t pos = i * bits;
+    int shift = pos & 63;
+    uint64_t v = words[pos >> 6] >> shift;
+    if (shift + bits > 64) {
+        v |= words[(pos >> 6) + 1] << (64 - shift);
+    }
+    return (bits == 64) ? v : (v & ((1ULL << bits) - 1));
+}
+
+inline void pack_bits(uint64_t* words, int64_t i, int bits, uint64_t v) {
+    if (bits == 0) return;
+    int64_t pos = i * bits;
+    int shift = pos & 63;
+    words[pos >> 6] |= v << shift;
+    if (shift + bits > 64) {
+        words[(pos >> 6) + 1] |= v >> (64 - shift);
+    }
+}
+
+inline bool is_op_file(string name) {
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    uint64_t magic = 0;
+    bool ret = (read(fd, &magic, sizeof(magic)) == sizeof(magic)) &&
+               magic == OP_FILE_MAGIC;
+    close(fd);
+    return ret;
+}
+
+inline void write_op_file(string file_name,
+                          slice<operation*, operation*> ops) {
+    printf("Will write columnar file '%s'\n", file_name.c_str());
+    int64_t n = ops.size();
+    int64_t num_blocks = (n + OP_FILE_BLOCK_SIZE - 1) / OP_FILE_BLOCK_SIZE;
+
+    // block layout
+    auto blocks = parlay::tabulate(num_blocks, [&](size_t b) {
+        op_file_block blk;
+        memset(&blk, 0, sizeof(blk));
+        int64_t l = b * OP_FILE_BLOCK_SIZE;
+        int64_t r = min(l + OP_FILE_BLOCK_SIZE, n);
+        blk.count = r - l;
+        int64_t lo = INT64_MAX, hi = INT64_MIN;
+        for (int64_t i = l; i < r; i++) {
+            blk.type_count[ops[i].type]++;
+            lo = min(lo, op_key(ops[i]));
+            hi = max(hi, op_key(ops[i]));
+        }
+        uint64_t range = (uint64_t)hi - (uint64_t)lo;
+        blk.key_base = lo;
+        blk.key_bits = (range == 0) ? 0 : 64 - __builtin_clzll(range);
+        if (op_file_raw_blocks && blk.count > 0 &&
+            block_type(blk) != operation_t::empty_t) {
+            blk.key_base = 0;
+            blk.key_bits = OP_FILE_RAW;
+        }
+        return blk;
+    });
+    auto sizes = parlay::tabulate(num_blocks, [&](size_t b) -> int64_t {
+        op_file_block& blk = blocks[b];
+        if (blk.key_bits == OP_FILE_RAW) {
+            return op_struct_size(block_type(blk)) * blk.count;
+        }
+        int64_t values = blk.type_count[operation_t::update_t] +
+                         blk.type_count[operation_t::insert_t] +
+                         blk.type_count[operation_t::scan_t];
+        return op_file_align(blk.count) +
+               S64(packed_words(blk.count, blk.key_bits)) + S64(values);
+    });
+    int64_t data_size = parlay::scan_inplace(sizes);
+    int64_t index_offset = sizeof(op_file_header) + data_size;
+    int64_t filesize = index_offset + sizeof(op_file_block) * num_blocks;
+
+    const char* filepath = file_name.c_str();
+    unlink(filepath);
+    int fd = open(filepath, O_RDWR | O_CREAT | O_TRUNC, (mode_t)0600);
+    if (fd == -1) {
+        perror("Error opening file for writing");
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, filesize) == -1) {
+        close(fd);
+        perror("Error calling ftruncate() to 'stretch' the file");
+        exit(EXIT_FAILURE);
+    }
+    void* map = mmap(0, filesize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        perror("Error mmapping the file");
+        exit(EXIT_FAILURE);
+    }
+    uint8_t* base = (uint8_t*)map;
+
+    op_file_header* header = (op_file_header*)base;
+    header->magic = OP_FILE_MAGIC;
+    header->version = OP_FILE_VERSION;
+    header->block_size = OP_FILE_BLOCK_SIZE;
+    header->n = n;
+    header->num_blocks = num_blocks;
+    header->index_offset = index_offset;
+
+    op_file_block* index = (op_file_block*)(base + index_offset);
+    parlay::parallel_for(0, num_blocks, [&](size_t b) {
+        op_file_block& blk = blocks[b];
+        int64_t l = b * OP_FILE_BLOCK_SIZE;
+        if (blk.key_bits == OP_FILE_RAW) {
+            int64_t size = op_struct_size(block_type(blk));
+            blk.type_offset = blk.value_offset = -1;
+            blk.key_offset = sizeof(op_file_header) + sizes[b];
+            index[b] = blk;
+            for (int64_t i = 0; i < blk.count; i++) {
+                memcpy(base + blk.key_offset + i * size, &ops[l + i].tsk,
+                       size);
+            }
+            return;
+        }
+        blk.type_offset = sizeof(op_file_header) + sizes[b];
+        blk.key_offset = blk.type_offset + op_file_align(blk.count);
+        blk.value_offset =
+            blk.key_offset + S64(packed_words(blk.count, blk.key_bits));
+        index[b] = blk;
+
+        uint8_t* types = base + blk.type_offset;
+        uint64_t* keys = (uint64_t*)(base + blk.key_offset);
+        int64_t* values = (int64_t*)(base + blk.value_offset);
+        memset(keys, 0, S64(packed_words(blk.count, blk.key_bits)));
+        int64_t v = 0;
+        for (int64_t i = 0; i < blk.count; i++) {
+            const operation& op = ops[l + i];
+            types[i] = (uint8_t)op.type;
+            pack_bits(keys, i, blk.key_bits,
+                      (uint64_t)op_key(op) - (uint64_t)blk.key_base);
+            if (op_has_value(op.type)) {
+                values[v++] = op_value(op);
+            }
+        }
+    });
+
+    if (msync(map, filesize, MS_SYNC) == -1) {
+        perror("Could not sync the file to disk");
+    }
+    if (munmap(map, filesize) == -1) {
+        close(fd);
+        perror("Error un-mmapping the file");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    printf("%ld operations, %ld bytes (%.2f bytes / operation)\n", n,
+           filesize, (double)filesize / max<int64_t>(n, 1));
+}
+
+// A run of the file: consecutive raw blocks of one type (raw_offset >= 0,
+// the operation structs start there), or consecutive other blocks.
+struct op_file_segment {
+    operation_t type;  // empty_t unless raw
+    int64_t first;
+    int64_t count;
+    int64_t raw_offset;
+};
+
+// Maps a columnar file and decodes ranges of it on demand; cut(l, r) has
+// the interface core::load_one_batch expects of its source.
+class op_file_reader {
+   public:
+    uint8_t* base;
+    int64_t filesize;
+    int64_t n;
+    op_file_header* header;
+    op_file_block* index;
+    vector<op_file_segment> segments;
+
+    op_file_reader(string name, int64_t limit = -1) {
+        int fd = open(name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            perror("Error opening file for reading");
+            exit(EXIT_FAILURE);
+        }
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) == -1) {
+            perror("Error getting the file size");
+            exit(EXIT_FAILURE);
+        }
+        filesize = fileInfo.st_size;
+        void* map = mmap(0, filesize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror("Error mmapping the file");
+            exit(EXIT_FAILURE);
+        }
+        base = (uint8_t*)map;
+        header = (op_file_header*)base;
+        if (filesize < (int64_t)sizeof(op_file_header) ||
+            header->magic != OP_FILE_MAGIC ||
+            header->version > OP_FILE_VERSION ||
+            header->block_size != OP_FILE_BLOCK_SIZE) {
+            fprintf(stderr, "Error: '%s' is not a columnar op file\n",
+                    name.c_str());
+            exit(EXIT_FAILURE);
+        }
+        index = (op_file_block*)(base + header->index_offset);
+        n = (limit == -1) ? header->n : min(limit, header->n);
+        madvise(base, filesize, MADV_SEQUENTIAL);
+        find_segments();
+        printf("Columnar file '%s': %ld operations in %ld blocks, "
+               "%lu segments\n",
+               name.c_str(), n, header->num_blocks, segments.size());
+    }
+
+    void find_segments() {
+        int64_t num_blocks = (n + OP_FILE_BLOCK_SIZE - 1) / OP_FILE_BLOCK_SIZE;
+        for (int64_t b = 0; b < num_blocks; b++) {
+            const op_file_block& blk = index[b];
+            bool raw = (blk.key_bits == OP_FILE_RAW);
+            operation_t t = raw ? block_type(blk) : operation_t::empty_t;
+            int64_t first = b * OP_FILE_BLOCK_SIZE;
+            int64_t count = min<int64_t>(blk.count, n - first);
+            if (!segments.empty() && segments.back().type == t) {
+                segments.back().count += count;
+            } else {
+                segments.push_back((op_file_segment){
+                    .type = t,
+                    .first = first,
+                    .count = count,
+                    .raw_offset = raw ? blk.key_offset : -1});
+            }
+        }
+    }
+
+    bool has_raw_segments() {
+        for (auto& seg : segments) {
+            if (seg.raw_offset >= 0) return true;
+        }
+        return false;
+    }
+
+    // start reading a raw segment ahead of its replay
+    void will_need(const op_file_segment& seg) {
+        int64_t page = sysconf(_SC_PAGESIZE);
+        int64_t l = seg.raw_offset / page * page;
+        int64_t r = seg.raw_offset + seg.count * op_struct_size(seg.type);
+        madvise(base + l, r - l, MADV_WILLNEED);
+    }
+
+    op_file_reader(const op_file_reader&) = delete;
+
+    ~op_file_reader() { munmap(base, filesize); }
+
+    int64_t size() { return n; }
+
+    // operations [l, r), decoded block by block in parallel
+    parlay::sequence<operation> cut(int64_t l, int64_t r) {
+        ASSERT(0 <= l && l <= r && r <= n);
+        auto ret = parlay::sequence<operation>::uninitialized(r - l);
+        int64_t bl = l / OP_FILE_BLOCK_SIZE;
+        int64_t br = (r + OP_FILE_BLOCK_SIZE - 1) / OP_FILE_BLOCK_SIZE;
+        parlay::parallel_for(bl, br, [&](size_t b) {
+            const op_file_block& blk = index[b];
+            int64_t start = b * OP_FILE_BLOCK_SIZE;
+            int64_t s = max(l, start) - start;
+            int64_t e = min(r, start + blk.count) - start;
+            if (blk.key_bits == OP_FILE_RAW) {
+                operation_t t = block_type(blk);
+                int64_t size = op_struct_size(t);
+                for (int64_t i = s; i < e; i++) {
+                    int64_t* p = (int64_t*)(base + blk.key_offset + i * size);
+                    ret[start + i - l] =
+                        make_op(t, p[0], op_has_value(t) ? p[1] : 0);
+                }
+                return;
+            }
+            uint8_t* types = base + blk.type_offset;
+            uint64_t* keys = (uint64_t*)(base + blk.key_offset);
+            int64_t* values = (int64_t*)(base + blk.value_offset);
+            int64_t v = 0;
+            for (int64_t i = 0; i < s; i++) {
+                v += op_has_value((operation_t)types[i]);
+            }
+            for (int64_t i = s; i < e; i++) {
+                operation_t t = (operation_t)types[i];
+                ASSERT(t >= 0 && t < OPERATION_NR_ITEMS);
+                int64_t key = (int64_t)(unpack_bits(keys, i, blk.key_bits) +
+                                        (uint64_t)blk.key_base);
+                int64_t value = op_has_value(t) ? values[v++] : 0;
+                ret[start + i - l] = make_op(t, key, value);
+            }
+        }, 1);
+        return ret;
+    }
+};
+
+// [l, r) of a file, as a source for core::execute
+struct op_file_range {
+    op_file_reader* reader;
+    int64_t l, r;
+
+    int64_t size() { return r - l; }
+
+    parlay::sequence<operation> cut(int64_t a, int64_t b) {
+        return reader->cut(l + a, l + b);
+    }
+};
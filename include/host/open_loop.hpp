@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "async_core.hpp"
+#include "random_generator.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// Open loop benchmark: operations arrive as a Poisson process at
+// open_loop_conf.arrival_rate, independent of how fast they complete, and
+// go through async_core's batcher. Latency is measured from the scheduled
+// arrival time, so a backlog shows up in the latency instead of silently
+// lowering the offered load.
+namespace open_loop {
+
+const char* operation_name[OPERATION_NR_ITEMS] = {
+    "empty", "get", "update", "predecessor", "scan", "insert", "remove"};
+
+inline int64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// scheduled arrival of each operation, in ns after the start
+inline parlay::sequence<int64_t> poisson_arrivals(int64_t n, double rate,
+                                                  rn_stream rn) {
+    auto gaps = parlay::tabulate(n, [&](size_t i) -> double {
+        // uniform in (0, 1)
+        double u = (((uint64_t)rn(i) >> 11) + 0.5) * 0x1.0p-53;
+        return -log(u) / rate * 1e9;
+    });
+    parlay::scan_inclusive_inplace(gaps);
+    return parlay::tabulate(n, [&](size_t i) { return (int64_t)gaps[i]; });
+}
+
+// sleeps until spin_ns before t, then yields; a submitter holds a core
+// only for the last few microseconds of each wait
+inline void wait_until(int64_t t) {
+    const int64_t spin_ns = 20000;
+    while (true) {
+        int64_t d = t - now_ns();
+        if (d <= 0) return;
+        if (d > spin_ns) {
+            this_thread::sleep_for(chrono::nanoseconds(d - spin_ns));
+        } else {
+            this_thread::yield();
+        }
+    }
+}
+
+inline void report(const char* name, parlay::sequence<int64_t> latency,
+                   double seconds) {
+    int64_t n = latency.size();
+    if (n == 0) return;
+    parlay::sort_inplace(latency);
+    auto pct = [&](double p) {
+        int64_t k = min(n - 1, (int64_t)ceil(p * n) - 1);
+        return latency[max<int64_t>(k, 0)] / 1e3;
+    };
+    printf(
+        "open loop %-12s n=%ld tput=%.0f/s latency(us) p50=%.1f p95=%.1f "
+        "p99=%.1f p999=%.1f max=%.1f\n",
+        name, n, n / seconds, pct(0.5), pct(0.95), pct(0.99), pct(0.999),
+        latency[n - 1] / 1e3);
+}
+
+};  // namespace open_loop
+
+void run_open_loop(frontend& f, int execute_batch_size) {
+    using namespace open_loop;
+    auto ops = f.test_tasks();
+    int64_t n = ops.size();
+    int clients = max(open_loop_conf.clients, 1);
+    printf("open loop n=%ld rate=%.0f/s window=%ldus clients=%d batch=%d\n",
+           n, open_loop_conf.arrival_rate, open_loop_conf.batch_window_us,
+           clients, execute_batch_size);
+
+    auto arrival = poisson_arrivals(n, open_loop_conf.arrival_rate,
+                                    rn_gen::next_stream());
+    auto completion = parlay::sequence<int64_t>(n, -1);
+
+    async_core::async_front_end fe(
+        execute_batch_size, open_loop_conf.batch_window_us,
+        core::num_top_level_threads, open_loop_conf.queue_capacity);
+    int64_t start = now_ns() + 1000000;
+
+    fe.serve([&]() {
+        vector<thread> submitters;
+        for (int c = 0; c < clients; c++) {
+            submitters.emplace_back([&, c]() {
+                for (int64_t i = c; i < n; i += clients) {
+                    wait_until(start + arrival[i]);
+                    auto done = [&completion, i]() {
+                        completion[i] = now_ns();
+                    };
+                    operation& op = ops[i];
+                    switch (op.type) {
+                        case operation_t::get_t: {
+                            fe.get(op.tsk.g.key, done);
+                            break;
+                        }
+                        case operation_t::predecessor_t: {
+                            fe.predecessor(op.tsk.p.key, done);
+                            break;
+                        }
+                        case operation_t::scan_t: {
+                            fe.scan(op.tsk.s.lkey, op.tsk.s.rkey, done);
+                            break;
+                        }
+                        case operation_t::insert_t: {
+                            fe.insert(op.tsk.i.key, op.tsk.i.value, done);
+                            break;
+                        }
+                        case operation_t::remove_t: {
+                            fe.remove(op.tsk.r.key, done);
+                            break;
+                        }
+                        default: {
+                            break;  // update is not supported by core
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& t : submitters) t.join();
+    });
+
+    auto latency = parlay::tabulate(n, [&](size_t i) -> int64_t {
+        return completion[i] < 0 ? -1 : completion[i] - (start + arrival[i]);
+    });
+    int64_t end = parlay::reduce(completion, parlay::maxm<int64_t>());
+    double seconds = max<int64_t>(end - start, 1) / 1e9;
+
+    for (int t = 1; t < OPERATION_NR_ITEMS; t++) {
+        auto idx = parlay::pack_index(parlay::delayed_seq<bool>(
+            n, [&](size_t i) { return ops[i].type == t && latency[i] >= 0; }));
+        report(operation_name[t],
+               parlay::tabulate(idx.size(),
+                                [&](size_t j) { return latency[idx[j]]; }),
+               seconds);
+    }
+    report("all", parlay::filter(latency, [](int64_t x) { return x >= 0; }),
+           seconds);
+}
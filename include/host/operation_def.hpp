@@ -1,7 +1,9 @@
 #pragma once 
+#include <cstdint>
 #include <cstdlib>
-
-const int MAX_BATCH_SIZE = 5e6;
+#include <vector>
+#include <parlay/slice.h>
+#include "value.hpp"
 
 enum operation_t {
     empty_t,
@@ -14,33 +16,32 @@ enum operation_t {
 };
 const int OPERATION_NR_ITEMS = 7;
 
-int op_count[OPERATION_NR_ITEMS];
 struct get_operation {
     int64_t key;
-} get_ops[MAX_BATCH_SIZE];
+};
 
 struct update_operation {
     int64_t key;
     int64_t value;
-} update_ops[MAX_BATCH_SIZE];
+};
 
 struct predecessor_operation {
     int64_t key;
-} predecessor_ops[MAX_BATCH_SIZE];
+};
 
 struct scan_operation {
     int64_t lkey;
     int64_t rkey;
-} scan_ops[MAX_BATCH_SIZE];
+};
 
 struct insert_operation {
     int64_t key;
     int64_t value;
-} insert_ops[MAX_BATCH_SIZE];
+};
 
 struct remove_operation {
     int64_t key;
-} remove_ops[MAX_BATCH_SIZE];
+};
 
 struct operation {
     union {
@@ -52,4 +53,81 @@ struct operation {
         remove_operation r;
     } tsk;
     operation_t type;
-};
\ No newline at end of file
+};
+
+// Bump allocator for batch columns. Chunks are kept across reset(), so an
+// arena reused for every batch stops allocating once it has seen the
+// largest one.
+class batch_arena {
+    struct chunk {
+        uint8_t* data;
+        size_t size;
+    };
+    std::vector<chunk> chunks;
+    size_t current, used;
+
+   public:
+    static const size_t MIN_CHUNK = (1 << 20);
+
+    batch_arena() : current(0), used(0) {}
+    batch_arena(const batch_arena&) = delete;
+    ~batch_arena() {
+        for (auto& c : chunks) free(c.data);
+    }
+
+    template <typename T>
+    T* alloc(int64_t n) {
+        size_t bytes = (n * sizeof(T) + 63) & ~(size_t)63;
+        while (current < chunks.size() &&
+               used + bytes > chunks[current].size) {
+            current++;
+            used = 0;
+        }
+        if (current == chunks.size()) {
+            size_t size = chunks.empty() ? MIN_CHUNK : chunks.back().size * 2;
+            size = (size > bytes) ? size : bytes;
+            chunks.push_back({(uint8_t*)aligned_alloc(64, size), size});
+            used = 0;
+        }
+        T* ret = (T*)(chunks[current].data + used);
+        used += bytes;
+        return ret;
+    }
+
+    void reset() { current = used = 0; }
+};
+
+// One batch of operations as columns: keys for get / predecessor / remove,
+// key-value pairs for update / insert (the layout their loads take) and
+// ranges for scans. Columns are allocated from the batch's arena and stay
+// valid until clear().
+struct operation_batch {
+    template <typename T>
+    using column_t = parlay::slice<T*, T*>;
+
+    batch_arena arena;
+    column_t<int64_t> get_keys = empty<int64_t>();
+    column_t<key_value> update_kvs = empty<key_value>();
+    column_t<int64_t> predecessor_keys = empty<int64_t>();
+    column_t<scan_operation> scans = empty<scan_operation>();
+    column_t<key_value> insert_kvs = empty<key_value>();
+    column_t<int64_t> remove_keys = empty<int64_t>();
+
+    template <typename T>
+    static column_t<T> empty() {
+        return parlay::make_slice((T*)nullptr, (T*)nullptr);
+    }
+
+    template <typename T>
+    column_t<T> column(int64_t n) {
+        T* p = arena.alloc<T>(n);
+        return parlay::make_slice(p, p + n);
+    }
+
+    void clear() {
+        arena.reset();
+        get_keys = predecessor_keys = remove_keys = empty<int64_t>();
+        update_kvs = insert_kvs = empty<key_value>();
+        scans = empty<scan_operation>();
+    }
+};
@@ -3,21 +3,197 @@
 #include <parlay/primitives.h>
 #include <parlay/range.h>
 #include <parlay/sequence.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include "random_generator.hpp"
 #include "value.hpp"
 using namespace std;
 
-class batch_parallel_oracle {
-    template <class TT>
-    struct copy_scan {
-        using T = TT;
-        copy_scan() : identity((key_value){.key = INT64_MIN, .value = INT64_MIN}) {}
-        T identity;
-        static T f(T a, T b) { return ((b.key == INT64_MIN) && (b.value == INT64_MIN)) ? a : b; }
-    };
+// Sorted, key-unique key_values cut into blocks of about block_size. A
+// batch rebuilds only the blocks it touches and the O(n / block_size) block
+// index, instead of the whole set.
+class blocked_kv_set {
+   public:
+    static constexpr int64_t block_size = 2048;
+
+    parlay::sequence<parlay::sequence<key_value>> blocks;
+    parlay::sequence<int64_t> firsts;   // first key of each block
+    parlay::sequence<int64_t> offsets;  // position of each block's first item
+    int64_t n = 0;
+
+    size_t size() const { return n; }
+
+    const key_value& operator[](size_t i) const {
+        size_t b = upper_bound(offsets.begin(), offsets.end(), (int64_t)i) -
+                   offsets.begin() - 1;
+        return blocks[b][i - offsets[b]];
+    }
+
+    // block holding the predecessor of key, there is one as long as the
+    // set holds INT64_MIN
+    size_t block_of(int64_t key) const {
+        return upper_bound(firsts.begin(), firsts.end(), key) - firsts.begin() - 1;
+    }
+
+    // the predecessor of key is blocks[b][j]
+    pair<size_t, size_t> locate(int64_t key) const {
+        size_t b = block_of(key);
+        auto& blk = blocks[b];
+        size_t j = upper_bound(blk.begin(), blk.end(), key,
+                               [](int64_t k, const key_value& kv) {
+                                   return k < kv.key;
+                               }) - blk.begin() - 1;
+        return make_pair(b, j);
+    }
+
+    // position of the predecessor of key
+    size_t find(int64_t key) const {
+        auto [b, j] = locate(key);
+        return offsets[b] + j;
+    }
+
+    // last i in [lo, hi) with get(i) <= key, given get(lo) <= key
+    template <class G>
+    static size_t gallop(size_t lo, size_t hi, int64_t key, G get) {
+        size_t step = 1;
+        while (lo + step < hi && get(lo + step) <= key) {
+            lo += step;
+            step *= 2;
+        }
+        size_t r = min(lo + step, hi);
+        while (r - lo > 1) {
+            size_t mid = (lo + r) >> 1;
+            if (get(mid) <= key) {
+                lo = mid;
+            } else {
+                r = mid;
+            }
+        }
+        return lo;
+    }
+
+    // f(i, b, j) for the predecessor blocks[b][j] of each of the m sorted
+    // keys key(i). Chunks of keys walk forward through the set with
+    // galloping searches, so close keys cost a few steps in a cached block
+    // instead of a fresh search from the root.
+    template <class K, class F>
+    void find_sorted(size_t m, K key, F f) const {
+        const size_t chunk = 1024;
+        size_t nb = blocks.size();
+        parlay::parallel_for(0, (m + chunk - 1) / chunk, [&](size_t c) {
+            size_t l = c * chunk, r = min(m, l + chunk);
+            size_t b = block_of(key(l)), j = 0;
+            for (size_t i = l; i < r; i++) {
+                int64_t k = key(i);
+                size_t next = gallop(b, nb, k, [&](size_t x) { return firsts[x]; });
+                if (next != b) {
+                    b = next;
+                    j = 0;
+                }
+                auto& blk = blocks[b];
+                j = gallop(j, blk.size(), k, [&](size_t x) { return blk[x].key; });
+                f(i, b, j);
+            }
+        });
+    }
+
+    // batch: m sorted keys key(i). f(blk, l, r) returns the new contents of
+    // block blk given the batch entries [l, r) that fall into it
+    template <class K, class F>
+    void update(size_t m, K key, F f) {
+        if (m == 0) return;
+        auto blk = parlay::tabulate(m, [&](size_t i) { return block_of(key(i)); });
+        auto starts = parlay::pack_index(parlay::delayed_seq<bool>(
+            m, [&](size_t i) { return i == 0 || blk[i] != blk[i - 1]; }));
+        size_t g = starts.size();
+
+        // new contents of the touched blocks, cut into pieces
+        auto content = parlay::tabulate(g, [&](size_t j) {
+            size_t l = starts[j], r = (j + 1 < g) ? starts[j + 1] : m;
+            return f(blocks[blk[l]], l, r);
+        });
+        auto pieces = parlay::map(content, [&](auto& c) -> int64_t {
+            int64_t len = c.size();
+            return len <= 2 * block_size ? (len > 0) : len / block_size;
+        });
+        auto touched = parlay::sequence<int64_t>(blocks.size(), -1);
+        parlay::parallel_for(0, g, [&](size_t j) { touched[blk[starts[j]]] = j; });
+
+        auto cnt = parlay::tabulate(blocks.size(), [&](size_t b) -> int64_t {
+            return touched[b] < 0 ? 1 : pieces[touched[b]];
+        });
+        auto [pos, total] = parlay::scan(cnt);
+        auto next = parlay::sequence<parlay::sequence<key_value>>(total);
+        parlay::parallel_for(0, blocks.size(), [&](size_t b) {
+            if (touched[b] < 0) {
+                next[pos[b]] = std::move(blocks[b]);
+                return;
+            }
+            auto& c = content[touched[b]];
+            int64_t len = c.size(), k = cnt[b];
+            parlay::parallel_for(0, k, [&](size_t p) {
+                next[pos[b] + p] = parlay::to_sequence(
+                    c.cut(len * p / k, len * (p + 1) / k));
+            });
+        });
+        blocks = std::move(next);
+        merge_small();
+        reindex();
+    }
+
+    // A block that fell below a quarter of block_size (after removes) joins
+    // the block before it; leading small blocks join the first larger one.
+    // Merged runs longer than 2 * block_size are cut again, as in update.
+    void merge_small() {
+        size_t nb = blocks.size();
+        auto small = [&](size_t b) {
+            return (int64_t)blocks[b].size() < block_size / 4;
+        };
+        auto num_small = parlay::reduce(parlay::delayed_seq<int64_t>(
+            nb, [&](size_t b) { return (int64_t)small(b); }));
+        if (nb < 2 || num_small == 0) return;
+        size_t first_big = parlay::reduce(
+            parlay::delayed_seq<size_t>(
+                nb, [&](size_t b) { return small(b) ? nb : b; }),
+            parlay::minm<size_t>());
+        auto heads = parlay::pack_index(parlay::delayed_seq<bool>(
+            nb, [&](size_t b) { return b == 0 || (!small(b) && b > first_big); }));
+        size_t g = heads.size();
+
+        auto content = parlay::tabulate(g, [&](size_t j) {
+            size_t l = heads[j], r = (j + 1 < g) ? heads[j + 1] : nb;
+            return parlay::flatten(parlay::make_slice(blocks).cut(l, r));
+        });
+        auto cnt = parlay::map(content, [&](auto& c) -> int64_t {
+            int64_t len = c.size();
+            return len <= 2 * block_size ? 1 : len / block_size;
+        });
+        auto [pos, total] = parlay::scan(cnt);
+        auto next = parlay::sequence<parlay::sequence<key_value>>(total);
+        parlay::parallel_for(0, g, [&](size_t j) {
+            auto& c = content[j];
+            int64_t len = c.size(), k = cnt[j];
+            if (k == 1) {
+                next[pos[j]] = std::move(c);
+                return;
+            }
+            parlay::parallel_for(0, k, [&](size_t p) {
+                next[pos[j] + p] = parlay::to_sequence(
+                    c.cut(len * p / k, len * (p + 1) / k));
+            });
+        });
+        blocks = std::move(next);
+    }
+
+    void reindex() {
+        firsts = parlay::map(blocks, [](auto& b) { return b[0].key; });
+        offsets = parlay::map(blocks, [](auto& b) { return (int64_t)b.size(); });
+        n = parlay::scan_inplace(offsets);
+    }
+};
 
+class batch_parallel_oracle {
     const int default_batch_size = 1e6;
 
     using kv_seq = parlay::slice<key_value*, key_value*>;
@@ -44,12 +220,14 @@ class batch_parallel_oracle {
     }
 
    public:
-    parlay::sequence<key_value> inserted;
+    blocked_kv_set inserted;
     batch_parallel_oracle() {
-        inserted = parlay::tabulate(1, [](size_t i) {
+        inserted.blocks = parlay::tabulate(1, [](size_t i) {
             (void)i;
-            return (key_value){.key = INT64_MIN, .value = INT64_MIN};
+            return parlay::sequence<key_value>(
+                1, (key_value){.key = INT64_MIN, .value = INT64_MIN});
         });
+        inserted.reindex();
     }
 
     template <typename kviterator>
@@ -58,11 +236,34 @@ class batch_parallel_oracle {
     }
 
     size_t predecessor_position(const int64_t& v) {
-        return kv_seq_find_by_key(parlay::make_slice(inserted), v);
+        return inserted.find(v);
     }
 
     key_value predecessor(const int64_t& v) {
-        return kv_seq_find_result_by_key(parlay::make_slice(inserted), v);
+        return inserted[inserted.find(v)];
+    }
+
+    // f(i, b, j) for the predecessor inserted.blocks[b][j] of each buf[i].
+    // Large batches are sorted and merged against the set, small ones (fewer
+    // keys than blocks) search independently: the block index they go
+    // through stays in cache.
+    template <typename i64iterator, class F>
+    void predecessor_batch_apply(
+        const parlay::slice<i64iterator, i64iterator>& buf, F f) {
+        size_t length = buf.size();
+        if (length < inserted.blocks.size()) {
+            parlay::parallel_for(0, length, [&](size_t i) {
+                auto [b, j] = inserted.locate(buf[i]);
+                f(i, b, j);
+            });
+            return;
+        }
+        auto order = parlay::sort(parlay::tabulate(length, [&](size_t i) {
+            return make_pair((int64_t)buf[i], i);
+        }));
+        inserted.find_sorted(
+            length, [&](size_t i) { return order[i].first; },
+            [&](size_t i, size_t b, size_t j) { f(order[i].second, b, j); });
     }
 
     template <typename i64iterator>
@@ -73,8 +274,11 @@ class batch_parallel_oracle {
         // using X = typename TT::nothing;
         static_assert(
             std::is_same<typename std::int64_t&, decltype(buf[0])>::value);
-        return parlay::tabulate(length,
-                                [&](size_t i) { return predecessor(buf[i]); });
+        auto result = parlay::sequence<key_value>(length);
+        predecessor_batch_apply(buf, [&](size_t i, size_t b, size_t j) {
+            result[i] = inserted.blocks[b][j];
+        });
+        return result;
     }
 
     template <typename i64iterator>
@@ -83,8 +287,11 @@ class batch_parallel_oracle {
         // static_assert(
         //     std::is_same<typename std::int64_t, decltype(buf[0])>::value);
         int length = buf.size();
-        return parlay::tabulate(
-            length, [&](size_t i) { return predecessor_position(buf[i]); });
+        auto result = parlay::sequence<size_t>(length);
+        predecessor_batch_apply(buf, [&](size_t i, size_t b, size_t j) {
+            result[i] = inserted.offsets[b] + j;
+        });
+        return result;
     }
 
     template <typename kviterator>
@@ -100,32 +307,34 @@ class batch_parallel_oracle {
                     return (i == 0) || (buffer_sorted[i].key != buffer_sorted[i - 1].key);
                 })));
 
-        int len = buf.size();
-
-        auto keys = parlay::delayed_seq<int64_t>(
-            len, [&](size_t i) { return buf[i].key; });
-
-        auto results = predecessor_position_batch(parlay::make_slice(keys));
-        parlay::parallel_for(0, len, [&](size_t i) {
-            if (buf[i].key == inserted[results[i]].key) {
-                inserted[results[i]].value = buf[i].value;
-            }
-        });
-        inserted = parlay::unique(parlay::merge(inserted, buf));
+        inserted.update(
+            buf.size(), [&](size_t i) { return buf[i].key; },
+            [&](const parlay::sequence<key_value>& blk, size_t l, size_t r) {
+                // the batch wins on equal keys
+                auto both = parlay::merge(
+                    blk, buf.cut(l, r),
+                    [](const key_value& a, const key_value& b) {
+                        return a.key < b.key;
+                    });
+                return parlay::pack(
+                    both, parlay::delayed_seq<bool>(both.size(), [&](size_t i) {
+                        return i + 1 == both.size() ||
+                               both[i].key != both[i + 1].key;
+                    }));
+            });
     }
 
     template <typename i64iterator>
     void remove_batch(const parlay::slice<i64iterator, i64iterator>& buffer) {
         auto keys = parlay::sort(buffer);
-        int len = keys.size();
-        auto results = predecessor_position_batch(parlay::make_slice(keys));
-        parlay::parallel_for(0, len, [&](size_t i) {
-            if (keys[i] == inserted[results[i]].key) {
-                inserted[results[i]] =
-                    (key_value){.key = INT64_MIN, .value = INT64_MIN};
-            }
-        });
-        inserted = parlay::unique(parlay::scan_inclusive(inserted, copy_scan<key_value>()));
+        inserted.update(
+            keys.size(), [&](size_t i) { return keys[i]; },
+            [&](const parlay::sequence<key_value>& blk, size_t l, size_t r) {
+                return parlay::filter(blk, [&](const key_value& kv) {
+                    return !binary_search(keys.begin() + l, keys.begin() + r,
+                                          kv.key);
+                });
+            });
     }
 
     key_value random_element() {
@@ -185,17 +394,20 @@ class batch_parallel_oracle {
 
     template <class T>
     auto scan_size_batch(slice<T*, T*>& ops) {
-        parlay::sort_inplace(
-            inserted, [&](key_value kv1, key_value kv2) -> bool {
-                return (kv1.key < kv2.key) ||
-                       ((kv1.key == kv2.key) && (kv1.value < kv2.value));
-            });
-        auto inserted_set =
-            parlay::unique(inserted, [&](key_value kv1, key_value kv2) -> bool {
-                return (kv1.key == kv2.key);
-            });
-        return parlay::tabulate(ops.size(), [&](int64_t i) {
-            return scan_size(inserted_set, ops[i]);
+        // [first key >= lkey, first key > rkey) of every scan, from one
+        // batched predecessor pass over the set for all 2m bounds
+        int64_t length = ops.size();
+        auto bounds = parlay::sequence<int64_t>(2 * length);
+        parlay::parallel_for(0, length, [&](size_t i) {
+            int64_t lkey = ops[i].lkey;
+            bounds[2 * i] = (lkey == INT64_MIN) ? lkey : lkey - 1;
+            bounds[2 * i + 1] = ops[i].rkey;
+        });
+        auto pos = predecessor_position_batch(parlay::make_slice(bounds));
+        return parlay::tabulate(length, [&](int64_t i) {
+            int64_t l = (ops[i].lkey == INT64_MIN) ? 0 : pos[2 * i] + 1;
+            int64_t r = max<int64_t>(l, pos[2 * i + 1] + 1);
+            return std::make_pair(l, r);
         });
     }
 };
@@ -1,16 +1,52 @@
 #pragma once
 
+#include <atomic>
+#include <iostream>
 #include <cstdlib>
+#include <ctime>
 #include <random>
 #include <vector>
 #include <algorithm>
+#include <parlay/parallel.h>
 #include <parlay/utilities.h>
 #include "debug.hpp"
 using namespace std;
 
+// Counter based stream: the i-th value depends only on (seed, stream id, i),
+// not on which worker draws it or how many workers there are.
+struct rn_stream {
+    uint64_t key;
+
+    static uint64_t mix(uint64_t x) {  // splitmix64 finalizer
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    int64_t operator()(uint64_t i) const {
+        return (int64_t)mix(key + i * 0x9e3779b97f4a7c15ULL);
+    }
+
+    // out[j] = (*this)(offset + j); the inner loop has no dependencies and
+    // is left to the compiler to vectorize
+    template <class Slice>
+    void fill(Slice out, uint64_t offset = 0) const {
+        const size_t block = 4096;
+        size_t n = out.size();
+        parlay::parallel_for(0, (n + block - 1) / block, [&](size_t b) {
+            size_t l = b * block, r = min(n, l + block);
+            for (size_t j = l; j < r; j++) {
+                out[j] = (*this)(offset + j);
+            }
+        });
+    }
+};
+
 class rn_gen {
    public:
     inline static vector<rn_gen> rand_gens;
+    inline static uint64_t seed = 0;
+    inline static atomic<uint64_t> stream_cnt = 0;
 
     static int64_t randint64_rand() {
         uint64_t v = rand();
@@ -23,22 +59,33 @@ class rn_gen {
         }
     }
 
-    static void init() {
-        srand(time(NULL));
-        // srand(137);
+    static void init(uint64_t _seed = time(NULL)) {
+        seed = _seed;
+        stream_cnt = 0;
+        srand(seed);
 
         int thread_num = parlay::num_workers();
-        cout<<"rand init: tn = " << thread_num << endl;
+        cout << "rand init: tn = " << thread_num << " seed = " << seed << endl;
+        rand_gens.clear();
         for (int i = 0; i < thread_num; i++) {
             rand_gens.emplace_back(randint64_rand());
         }
     }
 
+    // not reproducible across runs with different worker counts, use streams
     static int64_t parallel_rand() {
         int tid = parlay::worker_id();
         return rand_gens[tid].next();
     }
 
+    static rn_stream stream(uint64_t id) {
+        return rn_stream{rn_stream::mix(seed ^ rn_stream::mix(id + 1))};
+    }
+
+    // streams are numbered in the order they are requested, so a generator
+    // that asks for them from one thread sees the same streams every run
+    static rn_stream next_stream() { return stream(stream_cnt++); }
+
     rn_gen(size_t seed) : state(seed){};
     rn_gen() : state(0){};
     int64_t random(int64_t i) { return parlay::hash64(this->state + i); }
@@ -48,4 +95,4 @@ class rn_gen {
    private:
     size_t state = 0;
     
-};
\ No newline at end of file
+};
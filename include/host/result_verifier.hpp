@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <parlay/primitives.h>
+#include <parlay/parallel.h>
+#include "debug.hpp"
+#include "operation_def.hpp"
+#include "oracle.hpp"
+#include "random_generator.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// Checks DPU results against the oracle. Inline, every check runs on the
+// calling thread. In async mode checks are queued together with the oracle
+// updates, in execution order, and one background worker replays the
+// queue; a full queue blocks the producer. With sample_rate < 1 each read
+// is checked with that probability.
+class result_verifier {
+   public:
+    batch_parallel_oracle& oracle;
+    bool async = false;
+    double sample_rate = 1.0;
+    size_t capacity = 16;  // queued batches
+
+    // oracle size for threads that are not the oracle's owner
+    atomic<int64_t> oracle_size = 1;
+    atomic<int64_t> checked = 0;
+    atomic<int64_t> errors = 0;
+    atomic<uint64_t> sampled_batches = 0;
+
+    result_verifier(batch_parallel_oracle& _oracle) : oracle(_oracle) {}
+
+    // Runs main; in async mode the queue is replayed meanwhile on another
+    // parlay worker, as the oracle's batch operations run parlay code.
+    template <typename F>
+    void serve(F main) {
+        oracle_size = oracle.inserted.size();
+        if (!async) {
+            main();
+            return;
+        }
+        ASSERT(parlay::num_workers() > 1);
+        stopping = false;
+        running = true;
+        parlay::par_do(
+            [&]() {
+                main();
+                {
+                    unique_lock lock(queue_mutex);
+                    stopping = true;
+                }
+                not_empty.notify_one();
+            },
+            [&]() { loop(); });
+        running = false;
+    }
+
+    // wait until every queued check has run
+    void drain() {
+        unique_lock lock(queue_mutex);
+        idle.wait(lock, [&]() { return jobs.empty() && !busy; });
+    }
+
+    // positions in a batch of n reads to check
+    sequence<size_t> sample(size_t n) {
+        if (sample_rate >= 1.0) {
+            return parlay::tabulate(n, [](size_t i) { return i; });
+        }
+        // ids far from next_stream's, so sampling leaves generation alone
+        auto coin = rn_gen::stream((1ULL << 62) + sampled_batches++);
+        return parlay::pack_index(parlay::delayed_seq<bool>(n, [&](size_t i) {
+            return ((uint64_t)coin(i) >> 11) * 0x1.0p-53 < sample_rate;
+        }));
+    }
+
+    // keys[i] read out[i], absent keys read {INT64_MIN, INT64_MIN}
+    void get(sequence<int64_t> keys, sequence<key_value> out) {
+        submit([this, keys = std::move(keys), out = std::move(out)]() mutable {
+            auto pred = oracle.predecessor_batch(make_slice(keys));
+            auto expected = parlay::tabulate(pred.size(), [&](size_t i) {
+                if (pred[i].key != keys[i]) {
+                    return (key_value){.key = INT64_MIN, .value = INT64_MIN};
+                }
+                return pred[i];
+            });
+            compare("get", keys, out, expected);
+        });
+    }
+
+    void predecessor(sequence<int64_t> keys, sequence<key_value> out) {
+        submit([this, keys = std::move(keys), out = std::move(out)]() mutable {
+            auto expected = oracle.predecessor_batch(make_slice(keys));
+            compare("predecessor", keys, out, expected);
+        });
+    }
+
+    // ops[i] returned length[i] key_values
+    void scan(sequence<scan_operation> ops, sequence<int64_t> length) {
+        submit([this, ops = std::move(ops), length = std::move(length)]() {
+            auto s = make_slice(ops);
+            auto expected = oracle.scan_size_batch(s);
+            auto wrong = parlay::pack_index(parlay::delayed_seq<bool>(
+                ops.size(), [&](size_t i) {
+                    return expected[i].second - expected[i].first != length[i];
+                }));
+            for (size_t j = 0; j < min<size_t>(wrong.size(), 10); j++) {
+                size_t i = wrong[j];
+                printf("scan k=(%ld,%ld) v1_s=%ld v2_s=%ld\n", ops[i].lkey,
+                       ops[i].rkey, length[i],
+                       expected[i].second - expected[i].first);
+            }
+            count(ops.size(), wrong.size());
+        });
+    }
+
+    void insert(sequence<key_value> kvs) {
+        submit([this, kvs = std::move(kvs)]() {
+            oracle.insert_batch(make_slice(kvs));
+            oracle_size = oracle.inserted.size();
+        });
+    }
+
+    void remove(sequence<int64_t> keys) {
+        submit([this, keys = std::move(keys)]() {
+            oracle.remove_batch(make_slice(keys));
+            oracle_size = oracle.inserted.size();
+        });
+    }
+
+    // with e errors in k checked reads the error rate is e / k; with none it
+    // is below 3 / k at 95% confidence (rule of three)
+    void report() {
+        int64_t k = checked, e = errors;
+        if (k == 0) return;
+        if (e > 0) {
+            printf("verified %ld reads (sample rate %.4f): %ld errors, rate %.3e\n",
+                   k, sample_rate, e, (double)e / k);
+        } else {
+            printf("verified %ld reads (sample rate %.4f): no errors, rate < %.3e at 95%% confidence\n",
+                   k, sample_rate, 3.0 / k);
+        }
+    }
+
+   private:
+    atomic<bool> running = false;
+    mutex queue_mutex;
+    condition_variable not_empty, not_full, idle;
+    deque<function<void()>> jobs;
+    bool stopping = false;
+    bool busy = false;
+
+    void submit(function<void()> job) {
+        if (!running) {
+            job();
+            return;
+        }
+        {
+            unique_lock lock(queue_mutex);
+            not_full.wait(lock, [&]() { return jobs.size() < capacity; });
+            jobs.push_back(std::move(job));
+        }
+        not_empty.notify_one();
+    }
+
+    void loop() {
+        while (true) {
+            function<void()> job;
+            {
+                unique_lock lock(queue_mutex);
+                not_empty.wait(lock, [&]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                busy = true;
+            }
+            not_full.notify_one();
+            job();
+            {
+                unique_lock lock(queue_mutex);
+                busy = false;
+            }
+            idle.notify_all();
+        }
+    }
+
+    void compare(const char* name, const sequence<int64_t>& keys,
+                 const sequence<key_value>& out,
+                 const sequence<key_value>& expected) {
+        auto wrong = parlay::pack_index(parlay::delayed_seq<bool>(
+            keys.size(), [&](size_t i) { return out[i] != expected[i]; }));
+        for (size_t i : wrong) {
+            printf("%s [%8lu]\t", name, i);
+            cout << "k=" << keys[i] << "\tv1=" << out[i]
+                 << "\tv2=" << expected[i] << endl;
+        }
+        count(keys.size(), wrong.size());
+    }
+
+    void count(int64_t k, int64_t e) {
+        checked += k;
+        errors += e;
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <queue>
+#include <vector>
+#include <parlay/primitives.h>
+#include <parlay/parallel.h>
+#include "debug.hpp"
+#include "value.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// One sorted run of a scan's result, as returned by one DPU. data usually
+// points straight into the receive buffers (see IO_Task_Batch::reply_spans).
+struct scan_piece {
+    int op;  // index of the scan operation
+    const key_value* data;
+    int64_t length;
+};
+
+// Merges the pieces of num_ops scans into one contiguous sorted result,
+// in the layout of pim_skip_list::scan: all key_values, and for each
+// operation its [first, second) range in them.
+// Pieces of one operation that cover disjoint key ranges (the common case
+// when DPUs are partitioned by key) are concatenated in parallel; otherwise
+// the operation's pieces are k-way merged. Either way every key_value is
+// copied once, from the receive buffer to the output.
+template <typename PieceSeq>
+auto merge_scan_pieces(int num_ops, const PieceSeq& pieces) {
+    int64_t m = pieces.size();
+
+    // pieces of one operation become adjacent, ordered by their first key
+    auto order = parlay::tabulate(m, [&](size_t j) { return (int64_t)j; });
+    auto first_key = [&](int64_t j) {
+        return pieces[j].length > 0 ? pieces[j].data[0].key : INT64_MAX;
+    };
+    parlay::sort_inplace(order, [&](int64_t a, int64_t b) {
+        if (pieces[a].op != pieces[b].op) return pieces[a].op < pieces[b].op;
+        return first_key(a) < first_key(b);
+    });
+
+    // output position of each piece, and of each operation
+    auto piece_start = parlay::tabulate(
+        m, [&](size_t j) { return pieces[order[j]].length; });
+    int64_t total = parlay::scan_inplace(piece_start);
+
+    auto op_first = parlay::sequence<int64_t>(num_ops + 1, m);
+    parlay::parallel_for(0, m, [&](size_t j) {
+        if (j == 0 || pieces[order[j]].op != pieces[order[j - 1]].op) {
+            op_first[pieces[order[j]].op] = j;
+        }
+    });
+    // operations without pieces start where the next one does
+    for (int i = num_ops - 1; i >= 0; i--) {
+        op_first[i] = min(op_first[i], op_first[i + 1]);
+    }
+
+    auto ranges = parlay::tabulate(num_ops, [&](size_t i) {
+        int64_t l = op_first[i], r = op_first[i + 1];
+        int64_t s = (l < m) ? piece_start[l] : total;
+        int64_t e = (r < m) ? piece_start[r] : total;
+        return make_pair(s, e);
+    });
+
+    auto disjoint = parlay::tabulate(num_ops, [&](size_t i) -> bool {
+        for (int64_t j = op_first[i] + 1; j < op_first[i + 1]; j++) {
+            const scan_piece& a = pieces[order[j - 1]];
+            const scan_piece& b = pieces[order[j]];
+            if (a.length > 0 && b.length > 0 &&
+                !(a.data[a.length - 1].key < b.data[0].key)) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    auto result = parlay::sequence<key_value>::uninitialized(total);
+
+    // concatenation: one task per piece
+    parlay::parallel_for(0, m, [&](size_t j) {
+        const scan_piece& p = pieces[order[j]];
+        if (!disjoint[p.op]) {
+            return;
+        }
+        parlay::parallel_for(0, p.length, [&](size_t k) {
+            result[piece_start[j] + k] = p.data[k];
+        });
+    });
+
+    // k-way merge: one task per overlapping operation
+    auto overlapping = parlay::pack_index(parlay::delayed_seq<bool>(
+        num_ops, [&](size_t i) { return !disjoint[i]; }));
+    parlay::parallel_for(
+        0, overlapping.size(),
+        [&](size_t x) {
+            int i = overlapping[x];
+            using cursor = pair<key_value, pair<int64_t, int64_t>>;
+            auto cmp = [](const cursor& a, const cursor& b) {
+                return b.first < a.first;
+            };
+            priority_queue<cursor, vector<cursor>, decltype(cmp)> heap(cmp);
+            for (int64_t j = op_first[i]; j < op_first[i + 1]; j++) {
+                if (pieces[order[j]].length > 0) {
+                    heap.push(make_pair(pieces[order[j]].data[0],
+                                        make_pair(order[j], (int64_t)0)));
+                }
+            }
+            int64_t pos = ranges[i].first;
+            while (!heap.empty()) {
+                cursor c = heap.top();
+                heap.pop();
+                result[pos++] = c.first;
+                const scan_piece& p = pieces[c.second.first];
+                int64_t k = c.second.second + 1;
+                if (k < p.length) {
+                    heap.push(make_pair(p.data[k],
+                                        make_pair(c.second.first, k)));
+                }
+            }
+            ASSERT(pos == ranges[i].second);
+        },
+        1);
+
+    return make_pair(std::move(result), std::move(ranges));
+}
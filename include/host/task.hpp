@@ -1,14 +1,12 @@
 #pragma once
 
-#define TASK(NAME, ID, FIXED, LEN, CONTENT) \
-    struct NAME {                           \
-        static int id;                      \
-        static bool fixed;                  \
-        static int task_len;                \
-        struct CONTENT;                     \
-    };                                      \
-    int NAME::id = (ID);                    \
-    bool NAME::fixed = (FIXED);             \
+#define TASK(NAME, ID, FIXED, LEN, CONTENT)    \
+    struct NAME {                              \
+        static constexpr int id = (ID);        \
+        static constexpr bool fixed = (FIXED); \
+        static int task_len;                   \
+        struct CONTENT;                        \
+    };                                         \
     int NAME::task_len = (LEN);
 
 // #define is_variable_length(NAME) (NAME::fixed)
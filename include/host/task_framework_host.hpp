@@ -3,6 +3,7 @@
 #include "timer.hpp"
 #include "debug.hpp"
 #include "dpu_control.hpp"
+#include "host_buffer.hpp"
 #include "macro.h"
 #include "sort.hpp"
 #include "task_framework_common.h"
@@ -10,11 +11,13 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdbool>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <vector>
 #include <parlay/sequence.h>
 #include <parlay/primitives.h>
 #include <parlay/internal/integer_sort.h>
@@ -29,6 +32,21 @@ using namespace std;
 atomic<uint64_t> total_communication = 0;
 atomic<uint64_t> total_actual_communication = 0;
 
+// cumulative time split of all epochs (nanoseconds), see IO_Manager::exec
+struct epoch_time_split {
+    atomic<int64_t> epochs = 0;
+    atomic<int64_t> send = 0;
+    atomic<int64_t> dpu = 0;
+    atomic<int64_t> receive = 0;
+};
+inline epoch_time_split epoch_times;
+
+static inline int64_t epoch_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
 struct count_size {
     int32_t cnt;
     int32_t size;
@@ -68,6 +86,105 @@ enum State {
     supplying_responces
 };
 
+struct spilled_task {
+    int64_t idx;     // position in its block
+    int64_t offset;  // where it would have started in the send buffer
+    uint8_t* task;
+    int length;
+    uint8_t* reply;
+    int reply_length;
+};
+
+// Tasks that did not fit into their block's send buffer, and later their
+// replies (see IO_Manager::exec_spilled). Storage and records are reserved
+// with atomic bumps over segments that double in size and are kept for
+// reuse, so handed out pointers stay valid until the block is initialized
+// again.
+class task_spill {
+   public:
+    vector<spilled_task> tasks;  // by idx, filled by IO_Task_Block::finish
+
+    ~task_spill() {
+        for (int i = 0; i < SPILL_SEGMENTS; i++) {
+            delete[] bytes[i].load();
+            delete[] records[i].load();
+        }
+    }
+
+    // length bytes, 8 aligned
+    uint8_t* alloc(int64_t length) {
+        length = (length + sizeof(int64_t) - 1) / sizeof(int64_t) *
+                 sizeof(int64_t);
+        while (true) {
+            int64_t off = used.fetch_add(length);
+            int i = segment_of(off, SPILL_BYTES);
+            int64_t start = SPILL_BYTES * ((1ll << i) - 1);
+            int64_t size = SPILL_BYTES << i;
+            // a reservation crossing a segment end is dropped
+            if (off + length <= start + size) {
+                return segment(bytes[i], size) + (off - start);
+            }
+        }
+    }
+
+    spilled_task& record() {
+        int64_t k = count.fetch_add(1);
+        int i = segment_of(k, SPILL_RECORDS);
+        int64_t start = SPILL_RECORDS * ((1ll << i) - 1);
+        return segment(records[i], SPILL_RECORDS << i)[k - start];
+    }
+
+    // after all pushes
+    void collect() {
+        int64_t n = count.load();
+        tasks.resize(n);
+        for (int64_t k = 0, i = 0; k < n; i++) {
+            spilled_task* r = records[i].load();
+            for (int64_t j = 0; j < (SPILL_RECORDS << i) && k < n; j++, k++) {
+                tasks[k] = r[j];
+            }
+        }
+        sort(tasks.begin(), tasks.end(),
+             [](const spilled_task& a, const spilled_task& b) {
+                 return a.idx < b.idx;
+             });
+    }
+
+    void clear() {
+        tasks.clear();
+        used = 0;
+        count = 0;
+    }
+
+   private:
+    static constexpr int SPILL_SEGMENTS = 40;
+    static constexpr int64_t SPILL_BYTES = (1 << 20);
+    static constexpr int64_t SPILL_RECORDS = (1 << 10);
+    atomic<uint8_t*> bytes[SPILL_SEGMENTS] = {};
+    atomic<spilled_task*> records[SPILL_SEGMENTS] = {};
+    atomic<int64_t> used = 0;
+    atomic<int64_t> count = 0;
+
+    // segment i holds base << i items and starts at base * (2^i - 1)
+    static int segment_of(int64_t pos, int64_t base) {
+        return 63 - __builtin_clzll(pos / base + 1);
+    }
+
+    template <typename T>
+    static T* segment(atomic<T*>& slot, int64_t size) {
+        T* p = slot.load();
+        if (p == nullptr) {
+            T* fresh = new T[size];
+            if (slot.compare_exchange_strong(p, fresh)) {
+                p = fresh;
+            } else {
+                delete[] fresh;
+            }
+        }
+        return p;
+    }
+};
+
 class IO_Task_Block {
    public:
     int target;
@@ -79,6 +196,16 @@ class IO_Task_Block {
     int task_length;
     atomic<count_size> cs;
 
+    // What fits into this DPU's buffers, see set_limits. The tasks that fit
+    // are a prefix of the block, the rest is spilled and sent in a
+    // follow-up epoch.
+    int max_cnt = MAX_TASK_COUNT_PER_DPU_PER_BLOCK;
+    int64_t max_size = MAX_TASK_BUFFER_SIZE_PER_DPU;
+    int spilled = 0;  // set by finish
+    atomic<task_spill*> spill = nullptr;
+
+    ~IO_Task_Block() { delete spill.load(); }
+
     void init(Block_Content_Type ct, int task_type, uint8_t* _base,
               int64_t* offset_buf, int length, int target) {
         this->target = target;
@@ -92,9 +219,84 @@ class IO_Task_Block {
         }
         base64[0] = task_type;
         cs = (count_size){.cnt = 0, .size = CPU_DPU_BLOCK_HEADER};
+        max_cnt = MAX_TASK_COUNT_PER_DPU_PER_BLOCK;
+        max_size = MAX_TASK_BUFFER_SIZE_PER_DPU;
+        spilled = 0;
+        if (spill.load() != nullptr) {
+            spill.load()->clear();
+        }
         this->state = loading_tasks;
     }
 
+    // send_left: bytes left in the send buffer from base on, receive_left:
+    // bytes left for the replies of this block. For variable length replies
+    // reply_len is an upper bound of one reply (<= 0 if unknown, then only
+    // the offsets count).
+    void set_limits(int64_t send_left, int64_t receive_left, int reply_len,
+                    Block_Content_Type reply_ct) {
+        max_size = send_left;
+        int64_t reply_unit = (reply_ct == fixed_length)
+                                 ? reply_len
+                                 : max(reply_len, 0) + (int)sizeof(int64_t);
+        int64_t cap = MAX_TASK_COUNT_PER_DPU_PER_BLOCK;
+        if (reply_unit > 0) {
+            cap = min(cap, (receive_left - DPU_CPU_BLOCK_HEADER) / reply_unit);
+        }
+        max_cnt = (int)max<int64_t>(cap, 0);
+    }
+
+    // how many tasks of length bytes fit, for the bulk pushes
+    int fixed_capacity(int length) {
+        return (int)max<int64_t>(
+            0, min<int64_t>(max_cnt,
+                            (max_size - CPU_DPU_BLOCK_HEADER) / length));
+    }
+
+    task_spill* get_spill() {
+        task_spill* s = spill.load();
+        if (s == nullptr) {
+            task_spill* fresh = new task_spill();
+            if (spill.compare_exchange_strong(s, fresh)) {
+                s = fresh;
+            } else {
+                delete fresh;
+            }
+        }
+        return s;
+    }
+
+    // storage for count tasks of length bytes claimed at send_cs that do
+    // not fit into the send buffer
+    uint8_t* spill_tasks(count_size send_cs, int length, int count) {
+        task_spill* s = get_spill();
+        uint8_t* ret = s->alloc((int64_t)length * count);
+        for (int i = 0; i < count; i++) {
+            s->record() = (spilled_task){
+                .idx = send_cs.cnt + i,
+                .offset = send_cs.size + (int64_t)length * i,
+                .task = ret + (int64_t)length * i,
+                .length = length,
+                .reply = nullptr,
+                .reply_length = 0};
+        }
+        return ret;
+    }
+
+    // where count tasks of length bytes claimed at send_cs go
+    inline void* place(count_size send_cs, int length, int count) {
+        int64_t end = send_cs.size + (int64_t)length * count;
+        if (content_type == variable_length) {
+            end += S64((int64_t)send_cs.cnt + count);
+        }
+        if (send_cs.cnt + count <= max_cnt && end <= max_size) {
+            if (content_type == variable_length) {
+                offsets[send_cs.cnt] = send_cs.size;
+            }
+            return base + send_cs.size;
+        }
+        return spill_tasks(send_cs, length, count);
+    }
+
     void* push_task_zero_copy(int length, bool atomic, int* cnt) {
         ASSERT(state == loading_tasks);
         if (content_type == fixed_length) {
@@ -102,16 +304,10 @@ class IO_Task_Block {
             length = task_length;
         }
         count_size send_cs = inc_cs(&cs, 1, length, atomic);
-        ASSERT(send_cs.cnt < MAX_TASK_COUNT_PER_DPU_PER_BLOCK);
-        ASSERT_EXEC(send_cs.size < MAX_TASK_BUFFER_SIZE_PER_DPU,
-                    { printf("target=%d siz=%d\n", target, send_cs.size); });
         if (cnt != NULL) {
             *cnt = send_cs.cnt;
         }
-        if (content_type == variable_length) {
-            offsets[send_cs.cnt] = send_cs.size;
-        }
-        return base + send_cs.size;
+        return place(send_cs, length, 1);
     }
 
     void* push_multiple_tasks_zero_copy(int length, int count, bool atomic, int* cnt) {
@@ -119,18 +315,33 @@ class IO_Task_Block {
         ASSERT(content_type == fixed_length);
         length = task_length;
         count_size send_cs = inc_cs(&cs, count, count * length, atomic);
-        ASSERT(send_cs.cnt < MAX_TASK_COUNT_PER_DPU_PER_BLOCK);
-        ASSERT_EXEC(send_cs.size < MAX_TASK_BUFFER_SIZE_PER_DPU,
-                    { printf("target=%d siz=%d\n", target, send_cs.size); });
         if (cnt != NULL) {
             *cnt = send_cs.cnt;
         }
-        return base + send_cs.size;
+        return place(send_cs, length, count);
+    }
+
+    // a task past the prefix that went with the epoch, after finish
+    spilled_task& spilled_at(int i) {
+        ASSERT(i >= cs.load().cnt && i < cs.load().cnt + spilled);
+        return spill.load()->tasks[i - cs.load().cnt];
     }
 
     int finish() {
         ASSERT(state == loading_tasks);
         count_size finish_cs = cs.load();
+        task_spill* s = spill.load();
+        if (s != nullptr) {
+            s->collect();
+        }
+        if (s != nullptr && s->tasks.size() > 0) {
+            // only the prefix that fit goes to the DPU in this epoch
+            spilled = s->tasks.size();
+            finish_cs = (count_size){.cnt = (int)s->tasks[0].idx,
+                                     .size = (int)s->tasks[0].offset};
+            ASSERT(finish_cs.cnt + spilled == cs.load().cnt);
+            cs = finish_cs;
+        }
         int total_size = finish_cs.size;
         if (content_type == variable_length) {
             total_size += sizeof(int64_t) * finish_cs.cnt;
@@ -144,6 +355,9 @@ class IO_Task_Block {
 
     int count() { return cs.load().cnt; }
 
+    // after finish: count() went with the epoch, spilled follow
+    int total() { return count() + spilled; }
+
     int size() { return cs.load().size; }
 
     int expected_reply_length(int reply_length, Block_Content_Type ct) {
@@ -181,8 +395,18 @@ class IO_Task_Block {
         }
     }
 
+    // Fixed length replies received into caller memory: the block header is
+    // read from header, the i-th reply is at data + i * length.
+    void switch_to_external_reply(uint8_t* header, uint8_t* data, int length) {
+        switch_to_reply(header, length, fixed_length);
+        this->base = data - DPU_CPU_HEADER;
+        this->base64 = (int64_t*)this->base;
+    }
+
     void* ith(int i) {
-        ASSERT(i < cs.load().cnt);
+        if (i >= cs.load().cnt) {
+            return spilled_at(i).reply;
+        }
         uint8_t* ret;
         if (content_type == fixed_length) {
             i = DPU_CPU_HEADER + i * this->task_length;
@@ -196,21 +420,63 @@ class IO_Task_Block {
         }
         return ret;
     }
+
+    int ith_length(int i) {
+        count_size rep_cs = cs.load();
+        if (i >= rep_cs.cnt) {
+            return spilled_at(i).reply_length;
+        }
+        if (content_type == fixed_length) {
+            return this->task_length;
+        }
+        // the offset array follows the last reply
+        int64_t end = (i + 1 < rep_cs.cnt)
+                          ? offsets[i + 1]
+                          : (int64_t)rep_cs.size - S64(rep_cs.cnt);
+        return (int)(end - offsets[i]);
+    }
 } __attribute__((aligned(64)));
 
 enum Batch_Transmit_Type { broadcast, direct };
 
+// The tasks of a block as an array, for the bulk pushes: positions past
+// what fits into the send buffer are spilled.
+template <typename T>
+struct block_task_array {
+    IO_Task_Block* tb;
+    T* buffer;
+    int fit;
+
+    inline T& operator[](int64_t k) {
+        if (k < fit) {
+            return buffer[k];
+        }
+        count_size at = {.cnt = (int)k,
+                         .size = (int)(CPU_DPU_BLOCK_HEADER + k * sizeof(T))};
+        return *(T*)tb->spill_tasks(at, sizeof(T), 1);
+    }
+};
+
 struct task_idx {
     uint16_t id;
     int16_t size;
     uint32_t offset;
 };
 
+struct reply_span {
+    uint8_t* ptr;
+    int length;
+};
+
+// 512 pointers and the replies they prefetch stay within L1
+const int REPLY_GATHER_BLOCK_SIZE = 512;
+
 class IO_Task_Batch {
    public:
     Batch_Transmit_Type btt;
     State state;
     Block_Content_Type ct;
+    int task_type;
     int task_length;
     IO_Task_Block tbs[NR_DPUS];
 
@@ -221,6 +487,7 @@ class IO_Task_Batch {
         state = loading_tasks;
         btt = _btt;
         ct = _ct;
+        this->task_type = task_type;
         task_length = length;
 #ifdef KHB_CPU_DEBUG
         if (btt == broadcast) {
@@ -244,6 +511,16 @@ class IO_Task_Batch {
         }
     }
 
+    template <typename TaskType>
+    parlay::sequence<block_task_array<TaskType>> block_arrays() {
+        return parlay::tabulate(nr_of_dpus, [&](size_t i) {
+            return (block_task_array<TaskType>){
+                .tb = &tbs[i],
+                .buffer = (TaskType*)(tbs[i].base64 + CPU_DPU_BLOCK_HEADER_I64),
+                .fit = tbs[i].fixed_capacity(sizeof(TaskType))};
+        });
+    }
+
     template <bool id_from_func, typename TaskFunc, typename Id>  // g(task)
     void push_task_from_array_by_isort(int n, TaskFunc taskf, Id id,
                                        slice<int*, int*> location) {
@@ -253,9 +530,7 @@ class IO_Task_Batch {
         parlay::sequence<uint32_t> offset;
         int num_buckets = nr_of_dpus;
 
-        auto buffers = parlay::tabulate(nr_of_dpus, [&](size_t i) -> TaskType* {
-            return (TaskType*)(tbs[i].base64 + CPU_DPU_BLOCK_HEADER_I64);
-        });
+        auto buffers = block_arrays<TaskType>();
 
         auto counts = parlay::sequence<int>(nr_of_dpus);
 
@@ -263,7 +538,6 @@ class IO_Task_Batch {
                                        location, make_slice(counts));
 
         parlay::parallel_for(0, num_buckets, [&](size_t i) {
-            ASSERT(counts[i] < MAX_TASK_COUNT_PER_DPU_PER_BLOCK);
             tbs[i].cs = (count_size){
                 .cnt = (int)counts[i],
                 .size =
@@ -287,9 +561,7 @@ class IO_Task_Batch {
             }
         });
 
-        auto buffers = parlay::tabulate(nr_of_dpus, [&](size_t i) -> TaskType* {
-            return (TaskType*)(tbs[i].base64 + CPU_DPU_BLOCK_HEADER_I64);
-        });
+        auto buffers = block_arrays<TaskType>();
 
         auto counts = parlay::tabulate(
             nr_of_dpus, [&](size_t i) { return ends[i] - starts[i]; });
@@ -302,9 +574,6 @@ class IO_Task_Batch {
         });
 
         parlay::parallel_for(0, num_buckets, [&](size_t i) {
-            ASSERT_EXEC(counts[i] < MAX_TASK_COUNT_PER_DPU_PER_BLOCK, {
-                cout << "i=" << i << " count=" << counts[i] << endl;
-            });
             tbs[i].cs = (count_size){
                 .cnt = (int)counts[i],
                 .size =
@@ -313,6 +582,61 @@ class IO_Task_Batch {
         return;
     }
 
+    // Like push_task_from_array_by_isort, but identical tasks going to the
+    // same DPU are sent once. Every duplicate gets the location of the copy
+    // that was sent, so ith / gather_replies fan the shared reply out to all
+    // of them. Returns the number of tasks actually sent.
+    template <typename TaskFunc, typename IdFunc>  // g(index)
+    int push_task_from_array_dedup(int n, TaskFunc taskf, IdFunc g,
+                                   slice<int*, int*> location) {
+        using TaskType = decltype(taskf(0));
+        static_assert((sizeof(TaskType) % sizeof(uint64_t)) == 0);
+        if (n == 0) {
+            return 0;
+        }
+        auto tasks = parlay::tabulate(n, taskf);
+
+        // group by (target, hash), duplicates become adjacent
+        const int hash_bits = 40;
+        auto order = parlay::tabulate(n, [&](size_t i) {
+            const uint64_t* w = (const uint64_t*)&tasks[i];
+            uint64_t h = 0;
+            for (size_t k = 0; k < sizeof(TaskType) / sizeof(uint64_t); k++) {
+                h = parlay::hash64(h ^ w[k]);
+            }
+            uint64_t key = ((uint64_t)g(i) << hash_bits) |
+                           (h & ((1ull << hash_bits) - 1));
+            return make_pair(key, (uint32_t)i);
+        });
+        parlay::sort_inplace(order);
+
+        // a hash collision only costs a missed merge
+        auto group = parlay::tabulate(n, [&](size_t j) -> int {
+            if (j == 0) return 1;
+            return (order[j].first != order[j - 1].first) ||
+                   (memcmp(&tasks[order[j].second],
+                           &tasks[order[j - 1].second],
+                           sizeof(TaskType)) != 0);
+        });
+        auto heads = parlay::pack_index(group);
+        int m = heads.size();
+        parlay::scan_inclusive_inplace(group);
+
+        auto unique_location = parlay::sequence<int>(m);
+        push_task_sorted(
+            m, nr_of_dpus,
+            [&](size_t j) { return tasks[order[heads[j]].second]; },
+            [&](size_t j) {
+                return (int)(order[heads[j]].first >> hash_bits);
+            },
+            make_slice(unique_location));
+
+        parlay::parallel_for(0, n, [&](size_t j) {
+            location[order[j].second] = unique_location[group[j] - 1];
+        });
+        return m;
+    }
+
     template <typename F, typename G>
     void push_task_from_array(int length, F idx_generator, G task_generator) {
         if (length > 100000) {
@@ -364,6 +688,13 @@ class IO_Task_Batch {
                                                           cnt);
     }
 
+    // after finish
+    int64_t spilled_tasks() {
+        int r = (btt == broadcast) ? 1 : nr_of_dpus;
+        return parlay::reduce(parlay::delayed_seq<int64_t>(
+            r, [&](size_t i) -> int64_t { return tbs[i].spilled; }));
+    }
+
     bool finish(uint8_t** starts) {
         bool empty = true;
         auto tsk = [this, &starts, &empty](int i) {
@@ -399,6 +730,16 @@ class IO_Task_Batch {
         });
     }
 
+    void supply_external_responce(uint8_t** _headers, uint8_t** _datas,
+                                  int length) {
+        ASSERT(state == loading_finished);
+        ASSERT(btt == direct);
+        state = supplying_responces;
+        parlay::parallel_for(0, nr_of_dpus, [&](size_t i) {
+            tbs[i].switch_to_external_reply(_headers[i], _datas[i], length);
+        });
+    }
+
     void* ith(int receive_id, int offset) {
 #ifdef KHB_CPU_DEBUG
         if (btt == broadcast) {
@@ -416,8 +757,260 @@ class IO_Task_Batch {
     void* get_reply(int offset, int receive_id) {  // obsolete api
         return ith(receive_id, offset);
     }
+
+    // Copy the fixed length replies back into the original task order.
+    // id(i) is the DPU the i-th task was sent to, and location[i] is its
+    // position in that DPU's block (as filled by push_task_from_array_by_isort
+    // or push_task_sorted). Each block of indices first resolves and
+    // prefetches all its sources, then copies, so the random reads over the
+    // receive buffers overlap instead of stalling one by one.
+    template <typename Reply, typename IdFunc>
+    void gather_replies(IdFunc id, slice<int*, int*> location,
+                        slice<Reply*, Reply*> out) {
+        ASSERT(state == supplying_responces);
+        ASSERT(tbs[0].content_type == fixed_length);
+        ASSERT(tbs[0].task_length == (int)sizeof(Reply));
+        size_t n = out.size();
+        size_t num_blocks =
+            parlay::internal::num_blocks(n, REPLY_GATHER_BLOCK_SIZE);
+        parlay::parallel_for(
+            0, num_blocks,
+            [&](size_t b) {
+                size_t s = b * REPLY_GATHER_BLOCK_SIZE;
+                size_t e = min(s + REPLY_GATHER_BLOCK_SIZE, n);
+                Reply* src[REPLY_GATHER_BLOCK_SIZE];
+                for (size_t i = s; i < e; i++) {
+                    int receive_id = (btt == broadcast) ? 0 : (int)id(i);
+                    IO_Task_Block& tb = tbs[receive_id];
+                    if (location[i] < tb.count()) {
+                        src[i - s] =
+                            (Reply*)(tb.base + DPU_CPU_HEADER +
+                                     (int64_t)location[i] * sizeof(Reply));
+                    } else {
+                        src[i - s] = (Reply*)tb.ith(location[i]);
+                    }
+#if defined(__GNUC__) || defined(__clang__)
+                    __builtin_prefetch(src[i - s]);
+#endif
+                }
+                for (size_t i = s; i < e; i++) {
+                    out[i] = *src[i - s];
+                }
+            },
+            1);
+    }
+
+    // Same as gather_replies, for variable length replies: returns where
+    // each reply lives in the receive buffers, in the original task order.
+    template <typename IdFunc>
+    parlay::sequence<reply_span> reply_spans(int n, IdFunc id,
+                                             slice<int*, int*> location) {
+        ASSERT(state == supplying_responces);
+        return parlay::tabulate(n, [&](size_t i) {
+            int receive_id = (btt == broadcast) ? 0 : (int)id(i);
+            IO_Task_Block& tb = tbs[receive_id];
+            return (reply_span){.ptr = (uint8_t*)tb.ith(location[i]),
+                                .length = tb.ith_length(location[i])};
+        });
+    }
 };
 
+// A view over an IO_Task_Batch whose task type, reply type and transmit type
+// are known at compile time. Lengths and fixed/variable-ness are constexpr,
+// so push and ith skip the per-call content type and btt branches.
+template <typename Task, typename Reply, Batch_Transmit_Type BTT>
+class Typed_IO_Task_Batch {
+   public:
+    static constexpr bool task_fixed = Task::fixed;
+    static constexpr bool reply_fixed = Reply::fixed;
+    static constexpr int task_length = task_fixed ? (int)sizeof(Task) : -1;
+    static constexpr int reply_length = reply_fixed ? (int)sizeof(Reply) : -1;
+    static_assert(BTT == direct || (task_fixed && reply_fixed),
+                  "broadcast batches must be fixed length");
+
+    IO_Task_Batch* batch;
+
+    Typed_IO_Task_Batch(IO_Task_Batch* _batch) : batch(_batch) {
+        ASSERT(batch->btt == BTT);
+        ASSERT(!task_fixed || Task::task_len == task_length);
+        ASSERT(!reply_fixed || Reply::task_len == reply_length);
+    }
+
+    inline IO_Task_Block& block(int id) {
+        if constexpr (BTT == broadcast) {
+            ASSERT(id == -1);
+            return batch->tbs[0];
+        } else {
+            ASSERT(id >= 0 && id < nr_of_dpus);
+            return batch->tbs[id];
+        }
+    }
+
+    // length is ignored for fixed length tasks
+    inline void* push_task_zero_copy(int send_id, int length, bool atomic,
+                                     int* cnt = nullptr) {
+        ASSERT(batch->state == loading_tasks);
+        IO_Task_Block& tb = block(send_id);
+        if constexpr (task_fixed) {
+            length = task_length;
+        }
+        count_size send_cs = inc_cs(&tb.cs, 1, length, atomic);
+        if (cnt != nullptr) {
+            *cnt = send_cs.cnt;
+        }
+        return tb.place(send_cs, length, 1);
+    }
+
+    inline Task* push_task_zero_copy(int send_id, bool atomic,
+                                     int* cnt = nullptr) {
+        static_assert(task_fixed);
+        return (Task*)push_task_zero_copy(send_id, task_length, atomic, cnt);
+    }
+
+    inline int push_task(int send_id, const Task& task, bool atomic) {
+        static_assert(task_fixed);
+        int cnt;
+        *push_task_zero_copy(send_id, atomic, &cnt) = task;
+        return cnt;
+    }
+
+    template <bool id_from_func, typename TaskFunc, typename Id>
+    void push_task_from_array_by_isort(int n, TaskFunc taskf, Id id,
+                                       slice<int*, int*> location) {
+        static_assert(task_fixed);
+        batch->push_task_from_array_by_isort<id_from_func>(n, taskf, id,
+                                                           location);
+    }
+
+    template <typename TaskFunc, typename IdFunc>
+    void push_task_sorted(int n, int num_buckets, TaskFunc taskf, IdFunc g,
+                          slice<int*, int*> location) {
+        static_assert(task_fixed);
+        batch->push_task_sorted(n, num_buckets, taskf, g, location);
+    }
+
+    template <typename TaskFunc, typename IdFunc>
+    int push_task_from_array_dedup(int n, TaskFunc taskf, IdFunc g,
+                                   slice<int*, int*> location) {
+        static_assert(task_fixed);
+        return batch->push_task_from_array_dedup(n, taskf, g, location);
+    }
+
+    inline Reply* ith(int receive_id, int offset) {
+        IO_Task_Block& tb = block(receive_id);
+        if (offset >= tb.count()) {
+            return (Reply*)tb.ith(offset);
+        }
+        if constexpr (reply_fixed) {
+            return (Reply*)(tb.base + DPU_CPU_HEADER +
+                            (int64_t)offset * reply_length);
+        } else {
+            return (Reply*)(tb.base + tb.offsets[offset]);
+        }
+    }
+
+    inline int ith_length(int receive_id, int offset) {
+        if constexpr (reply_fixed) {
+            return reply_length;
+        } else {
+            return block(receive_id).ith_length(offset);
+        }
+    }
+
+    template <typename IdFunc>
+    void gather_replies(IdFunc id, slice<int*, int*> location,
+                        slice<Reply*, Reply*> out) {
+        static_assert(reply_fixed);
+        batch->gather_replies(id, location, out);
+    }
+};
+
+const int NUM_IO_MANAGERS = 5;
+
+// Send/receive buffers are borrowed from a shared pool between
+// IO_Manager::init() and IO_Manager::reset(), and the replies live in them,
+// so they are only readable until reset. Buffers are allocated on demand
+// and at most capacity of them are kept, so resident memory follows the
+// number of managers loading or holding replies at the same time, not the
+// number of managers.
+struct transfer_buffer {
+    uint8_t (*direct_buffer)[MAX_TASK_BUFFER_SIZE_PER_DPU];
+    int64_t (*direct_offsets)[MAX_TASK_COUNT_PER_DPU_PER_BLOCK];
+};
+
+class transfer_buffer_pool {
+   private:
+    mutex pool_mutex;
+    vector<transfer_buffer> free_buffers;
+    int allocated;
+    int capacity;
+
+    static transfer_buffer alloc_buffer() {
+        transfer_buffer b;
+        b.direct_buffer = (uint8_t(*)[MAX_TASK_BUFFER_SIZE_PER_DPU])
+            host_buffer::alloc_dpu_buffers(MAX_TASK_BUFFER_SIZE_PER_DPU,
+                                           NR_DPUS);
+        b.direct_offsets = (int64_t(*)[MAX_TASK_COUNT_PER_DPU_PER_BLOCK])
+            host_buffer::alloc_dpu_buffers(
+                sizeof(int64_t) * MAX_TASK_COUNT_PER_DPU_PER_BLOCK, NR_DPUS);
+        return b;
+    }
+
+    static void free_buffer(transfer_buffer b) {
+        host_buffer::free_dpu_buffers((uint8_t*)b.direct_buffer,
+                                      MAX_TASK_BUFFER_SIZE_PER_DPU, NR_DPUS);
+        host_buffer::free_dpu_buffers(
+            (uint8_t*)b.direct_offsets,
+            sizeof(int64_t) * MAX_TASK_COUNT_PER_DPU_PER_BLOCK, NR_DPUS);
+    }
+
+   public:
+    transfer_buffer_pool(int _capacity) : allocated(0), capacity(_capacity) {}
+
+    void set_capacity(int _capacity) {
+        ASSERT(_capacity >= 1);
+        unique_lock lock(pool_mutex);
+        capacity = _capacity;
+        while (allocated > capacity && !free_buffers.empty()) {
+            free_buffer(free_buffers.back());
+            free_buffers.pop_back();
+            allocated--;
+        }
+    }
+
+    int allocated_buffers() {
+        unique_lock lock(pool_mutex);
+        return allocated;
+    }
+
+    // Never blocks: waiting could deadlock a thread that holds several
+    // managers. Beyond the capacity a buffer is allocated anyway and freed
+    // again when it comes back.
+    transfer_buffer borrow() {
+        unique_lock lock(pool_mutex);
+        if (free_buffers.empty()) {
+            allocated++;
+            lock.unlock();
+            return alloc_buffer();
+        }
+        transfer_buffer b = free_buffers.back();
+        free_buffers.pop_back();
+        return b;
+    }
+
+    void give_back(transfer_buffer b) {
+        unique_lock lock(pool_mutex);
+        if (allocated > capacity) {
+            allocated--;
+            free_buffer(b);
+            return;
+        }
+        free_buffers.push_back(b);
+    }
+};
+
+inline transfer_buffer_pool transfer_buffers(NUM_IO_MANAGERS);
+
 class IO_Manager {
    private:
     int64_t offsets[MAX_IO_BLOCKS][NR_DPUS];
@@ -425,8 +1018,8 @@ class IO_Manager {
     Block_Content_Type reply_ct[MAX_IO_BLOCKS];
     int cnt, size, broadcast_cnt, direct_cnt;
 
-    // memory buffers
-    int64_t direct_offsets[NR_DPUS][MAX_TASK_COUNT_PER_DPU_PER_BLOCK];
+    // memory buffers, borrowed from transfer_buffers
+    int64_t (*direct_offsets)[MAX_TASK_COUNT_PER_DPU_PER_BLOCK];
     uint8_t (*direct_buffer)[MAX_TASK_BUFFER_SIZE_PER_DPU];
     uint8_t* direct_buffer_heads[NR_DPUS];
     uint8_t* direct_buffer_tails[NR_DPUS];
@@ -441,6 +1034,17 @@ class IO_Manager {
     int64_t broadcast_batch_offsets[1][MAX_IO_BLOCKS];
     int broadcast_receive_length[1];
 
+    // zero-copy receive destination, see receive_into
+    uint8_t* receive_dest;
+    int64_t receive_stride;
+
+    // reply bytes of the finished blocks, and whether one of them spilled,
+    // per DPU; they bound the next block (see IO_Task_Block::set_limits)
+    int64_t reply_used[NR_DPUS];
+    bool spilling[NR_DPUS];
+    bool has_spilled;
+    IO_Manager* follow = nullptr;  // runs the spilled tasks, see exec_spilled
+
    public:
     size_t tid; // the worker id of the controlling thread
     int id; // the id of this io manager
@@ -450,27 +1054,64 @@ class IO_Manager {
     IO_Task_Batch tbs[MAX_IO_BLOCKS];
 
     IO_Manager() {
-        direct_buffer = new uint8_t[NR_DPUS][MAX_TASK_BUFFER_SIZE_PER_DPU];
-        memset(direct_buffer, 0,
-               sizeof(uint8_t) * NR_DPUS * MAX_TASK_BUFFER_SIZE_PER_DPU);
+        direct_buffer = nullptr;
+        direct_offsets = nullptr;
+    }
+
+    // The first borrow allocates, after the DPUs (and their ranks' NUMA
+    // nodes) are known.
+    void borrow_transfer_buffer() {
+        ASSERT(direct_buffer == nullptr);
+        transfer_buffer b = transfer_buffers.borrow();
+        direct_buffer = b.direct_buffer;
+        direct_offsets = b.direct_offsets;
+    }
+
+    void release_transfer_buffer() {
+        if (direct_buffer == nullptr) {
+            return;
+        }
+        transfer_buffers.give_back((transfer_buffer){
+            .direct_buffer = direct_buffer, .direct_offsets = direct_offsets});
+        direct_buffer = nullptr;
+        direct_offsets = nullptr;
     }
 
+    // hand a manager (and its replies) over to the calling worker
+    void adopt() {
+        unique_lock wLock(alloc_io_manager_mutex);
+        ASSERT(io_manager_state != idle);
+        tid = worker_id();
+    }
+
+    // Returns the transfer buffer to the pool, so ith(), gather_replies()
+    // and reply spans must not be read after reset. (With a buffer per
+    // manager they stayed readable until the manager's next epoch.)
     void reset() {
         unique_lock wLock(alloc_io_manager_mutex);
         ASSERT(tid == worker_id());
         tid = (size_t)-1;
+        release_transfer_buffer();
         io_manager_state = idle;
     }
 
     void init() {
         ASSERT(io_manager_state == pre_init);
         ASSERT(tid == worker_id());
+        if (direct_buffer == nullptr) {
+            borrow_transfer_buffer();
+        }
         cnt = 0;
         broadcast_cnt = direct_cnt = 0;
+        receive_dest = nullptr;
+        receive_stride = 0;
+        has_spilled = false;
         broadcast_buffer_head[0] = broadcast_buffer[0] + CPU_DPU_HEADER;
         broadcast_receive_length[0] = 0;
         broadcast_batch_offsets[0][0] = CPU_DPU_HEADER;
         for (int i = 0; i < nr_of_dpus; i++) {
+            reply_used[i] = 0;
+            spilling[i] = false;
             direct_receive_length[i] = 0;
             direct_buffer_heads[i] = direct_buffer[i] + CPU_DPU_HEADER;
             direct_batch_offsets[i][0] = CPU_DPU_HEADER;
@@ -508,6 +1149,7 @@ class IO_Manager {
                         direct_offsets, -1);
             }
         }
+        set_limits(tb, reply_len, receive_ct);
         io_manager_state = loading_tasks;
         tb.state = loading_tasks;
         return &tb;
@@ -527,6 +1169,52 @@ class IO_Manager {
                                 reply_len);
     }
 
+    template <typename Task, typename Reply, Batch_Transmit_Type BTT>
+    Typed_IO_Task_Batch<Task, Reply, BTT> alloc_typed() {
+        return Typed_IO_Task_Batch<Task, Reply, BTT>(alloc<Task, Reply>(BTT));
+    }
+
+    // What the new block tb can take on each DPU without overflowing the
+    // buffers on either side. On a DPU where an earlier block spilled, it
+    // spills entirely, so the follow-up epoch keeps the block order.
+    void set_limits(IO_Task_Batch& tb, int reply_len,
+                    Block_Content_Type receive_ct) {
+        int64_t broadcast_used =
+            broadcast_buffer_head[0] - broadcast_buffer[0] - CPU_DPU_HEADER;
+        auto direct_used = [&](size_t j) -> int64_t {
+            return direct_buffer_heads[j] - direct_buffer[j] - CPU_DPU_HEADER;
+        };
+        auto send_left = [&](int64_t used) {
+            return MAX_TASK_BUFFER_SIZE_PER_DPU - CPU_DPU_HEADER -
+                   broadcast_used - used - S64(MAX_IO_BLOCKS);
+        };
+        auto receive_left = [&](size_t j) {
+            return MAX_TASK_BUFFER_SIZE_PER_DPU - DPU_CPU_HEADER -
+                   S64(MAX_IO_BLOCKS) - reply_used[j];
+        };
+        if (tb.btt == broadcast) {
+            int64_t max_used = parlay::reduce(
+                parlay::delayed_seq<int64_t>(nr_of_dpus, direct_used),
+                parlay::maxm<int64_t>());
+            int64_t min_left = parlay::reduce(
+                parlay::delayed_seq<int64_t>(nr_of_dpus, receive_left),
+                parlay::minm<int64_t>());
+            tb.tbs[0].set_limits(send_left(max_used), min_left, reply_len,
+                                 receive_ct);
+            if (has_spilled) {
+                tb.tbs[0].max_cnt = 0;
+            }
+        } else {
+            parlay::parallel_for(0, nr_of_dpus, [&](size_t j) {
+                tb.tbs[j].set_limits(send_left(direct_used(j)),
+                                     receive_left(j), reply_len, receive_ct);
+                if (spilling[j]) {
+                    tb.tbs[j].max_cnt = 0;
+                }
+            });
+        }
+    }
+
     void finish_task_batch() {
         ASSERT(io_manager_state == loading_tasks);
         int i = cnt - 1;
@@ -547,10 +1235,108 @@ class IO_Manager {
                        MAX_TASK_BUFFER_SIZE_PER_DPU);
             }
         }
+        IO_Task_Batch& tb = tbs[i];
+        if (tb.btt == broadcast) {
+            int64_t r = DPU_CPU_BLOCK_HEADER +
+                        tb.tbs[0].expected_reply_length(reply_length[i],
+                                                        fixed_length);
+            bool s = tb.tbs[0].spilled > 0;
+            parlay::parallel_for(0, nr_of_dpus, [&](size_t j) {
+                reply_used[j] += r;
+                spilling[j] = spilling[j] || s;
+            });
+        } else {
+            parlay::parallel_for(0, nr_of_dpus, [&](size_t j) {
+                reply_used[j] += DPU_CPU_BLOCK_HEADER +
+                                 tb.tbs[j].expected_reply_length(
+                                     reply_length[i], reply_ct[i]);
+                spilling[j] = spilling[j] || (tb.tbs[j].spilled > 0);
+            });
+        }
+        has_spilled = has_spilled || (tb.spilled_tasks() > 0);
         io_manager_state = loading_finished;
         tbs[i].state = loading_finished;
     }
 
+    // whether any task fit into this epoch
+    bool sends_tasks() {
+        for (int i = 0; i < cnt; i++) {
+            int r = (tbs[i].btt == broadcast) ? 1 : nr_of_dpus;
+            for (int j = 0; j < r; j++) {
+                if (tbs[i].tbs[j].count() > 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Sends the spilled tasks of all blocks in a follow-up epoch, which
+    // spills again if it has to, and keeps their replies with the tasks,
+    // where ith() finds them. The follow-up manager is kept for the next
+    // time; it only holds a transfer buffer while it runs.
+    bool exec_spilled() {
+        if (follow == nullptr) {
+            follow = new IO_Manager();
+            follow->id = -1;
+        }
+        follow->tid = worker_id();
+        follow->io_manager_state = pre_init;
+        follow->init();
+        int from[MAX_IO_BLOCKS];  // our block of each follow-up block
+        int m = 0;
+        int64_t sent = 0;
+        for (int i = 0; i < cnt; i++) {
+            IO_Task_Batch& tb = tbs[i];
+            if (tb.spilled_tasks() == 0) {
+                continue;
+            }
+            from[m++] = i;
+            IO_Task_Batch* fb =
+                follow->alloc_task_batch(tb.btt, tb.ct, reply_ct[i],
+                                         tb.task_type, tb.task_length,
+                                         reply_length[i]);
+            int r = (tb.btt == broadcast) ? 1 : nr_of_dpus;
+            parlay::parallel_for(0, r, [&](size_t j) {
+                IO_Task_Block& b = tb.tbs[j];
+                for (int k = b.count(); k < b.total(); k++) {
+                    spilled_task& t = b.spilled_at(k);
+                    void* p = fb->push_task_zero_copy(
+                        (tb.btt == broadcast) ? -1 : (int)j,
+                        (tb.ct == fixed_length) ? -1 : t.length, false);
+                    memcpy(p, t.task, t.length);
+                }
+            });
+            follow->finish_task_batch();
+            sent += parlay::reduce(parlay::delayed_seq<int64_t>(
+                r, [&](size_t j) { return fb->tbs[j].count(); }));
+        }
+        if (sent == 0) {
+            printf("a task does not fit into an empty epoch\n");
+            follow->reset();
+            return false;
+        }
+
+        bool ret = follow->exec();
+        for (int f = 0; f < m; f++) {
+            IO_Task_Batch& tb = tbs[from[f]];
+            IO_Task_Batch& fb = follow->tbs[f];
+            int r = (tb.btt == broadcast) ? 1 : nr_of_dpus;
+            parlay::parallel_for(0, r, [&](size_t j) {
+                IO_Task_Block& b = tb.tbs[j];
+                for (int k = b.count(); ret && k < b.total(); k++) {
+                    spilled_task& t = b.spilled_at(k);
+                    int f_k = k - b.count();
+                    t.reply_length = fb.tbs[j].ith_length(f_k);
+                    t.reply = b.spill.load()->alloc(t.reply_length);
+                    memcpy(t.reply, fb.tbs[j].ith(f_k), t.reply_length);
+                }
+            });
+        }
+        follow->reset();
+        return ret;
+    }
+
     void print_all_buffer(bool x16 = false) {
         bool sending = (io_manager_state == loading_tasks ||
                         io_manager_state == loading_finished);
@@ -787,9 +1573,49 @@ class IO_Manager {
         return *maxele;
     }
 
-    void receive_from_direct(int offset, int length) {
+    // Zero-copy receive for an epoch holding a single direct, fixed length
+    // block: the replies of DPU i are transferred straight to
+    // dest + i * stride instead of the transfer buffer, and ith() reads them
+    // there. Only the headers go to the transfer buffer. Call after
+    // finish_task_batch and before exec. Returns false, and the replies go
+    // to the transfer buffer as usual, unless the epoch qualifies and
+    // stride >= zero_copy_stride(); ith() finds them either way.
+    bool receive_into(uint8_t* dest, int64_t stride) {
+        ASSERT(io_manager_state == loading_finished);
+        receive_dest = nullptr;
+        receive_stride = 0;
+        if (cnt != 1 || direct_cnt != 1 || reply_ct[0] != fixed_length ||
+            (stride % sizeof(int64_t)) != 0 || stride < zero_copy_stride()) {
+            return false;
+        }
+        receive_dest = dest;
+        receive_stride = stride;
+        return true;
+    }
+
+    template <typename Reply>
+    bool receive_into(Reply* dest, int64_t stride_in_replies) {
+        if (reply_length[0] != (int)sizeof(Reply)) {
+            return false;
+        }
+        return receive_into((uint8_t*)dest, stride_in_replies * sizeof(Reply));
+    }
+
+    // minimum per-DPU stride for receive_into, in bytes
+    int64_t zero_copy_stride() {
+        ASSERT(cnt == 1 && tbs[0].state == loading_finished);
+        auto counts = parlay::delayed_seq<int64_t>(
+            nr_of_dpus, [&](size_t i) { return tbs[0].tbs[i].count(); });
+        int64_t max_count = parlay::reduce(counts, parlay::maxm<int64_t>());
+        int64_t length = max_count * reply_length[0];
+        return (length + sizeof(int64_t) - 1) / sizeof(int64_t) *
+               sizeof(int64_t);
+    }
+
+    template <typename F>
+    void receive_from_direct_to(F dest, int offset, int length) {
         DPU_FOREACH(dpu_set, dpu, each_dpu) {
-            DPU_ASSERT(dpu_prepare_xfer(dpu, direct_buffer[each_dpu] + offset));
+            DPU_ASSERT(dpu_prepare_xfer(dpu, dest(each_dpu)));
         }
 #ifdef IRAM_FRIENDLY
         DPU_ASSERT(dpu_push_xfer(
@@ -804,6 +1630,21 @@ class IO_Manager {
 #endif
     }
 
+    void receive_from_direct(int offset, int length) {
+        receive_from_direct_to(
+            [&](uint32_t i) { return direct_buffer[i] + offset; }, offset,
+            length);
+    }
+
+    void receive_zero_copy(int direct_length) {
+        ASSERT(direct_length <= receive_stride);
+        const int header_length = DPU_CPU_HEADER + DPU_CPU_BLOCK_HEADER;
+        receive_from_direct(0, header_length);
+        receive_from_direct_to(
+            [&](uint32_t i) { return receive_dest + receive_stride * i; },
+            header_length, direct_length);
+    }
+
     void receive_from_broadcast(int offset, int length) {
         DPU_FOREACH(dpu_set, dpu, each_dpu) {
             if (each_dpu == 0) {  // !!! ???
@@ -835,6 +1676,9 @@ class IO_Manager {
 
         ASSERT(broadcast_cnt != 0 || broadcast_length == 0);
         ASSERT(direct_cnt != 0 || direct_length == 0);
+        if (receive_dest != nullptr && direct_length > receive_stride) {
+            receive_dest = nullptr;  // does not fit, use the transfer buffer
+        }
         time_end("pre_working");
 
 #ifndef KHB_CPU_DEBUG
@@ -848,6 +1692,8 @@ class IO_Manager {
         time_nested("trigger", [&]() {
             if (direct_cnt == 0) {  // only broadcast, one DPU_CPU_HEADER
                 receive_from_broadcast(0, receive_length);
+            } else if (receive_dest != nullptr) {
+                receive_zero_copy(direct_length);
             } else if (broadcast_cnt == 0) {
                 receive_from_direct(0, receive_length);
             } else {  // receive all DPU_CPU_HEADERS independently
@@ -953,6 +1799,23 @@ class IO_Manager {
         });
 #endif
 
+        if (receive_dest != nullptr) {
+            // fixed length replies: the expected length is exact and the only
+            // block starts right after the header
+            time_nested("post receiving", [&]() {
+                uint8_t* headers[NR_DPUS];
+                uint8_t* datas[NR_DPUS];
+                for (int j = 0; j < nr_of_dpus; j++) {
+                    headers[j] = direct_buffer[j] + DPU_CPU_HEADER;
+                    datas[j] = receive_dest + receive_stride * j;
+                }
+                tbs[0].supply_external_responce(headers, datas,
+                                                reply_length[0]);
+            });
+            io_manager_state = supplying_responces;
+            return true;
+        }
+
         int64_t lengths[NR_DPUS];
         time_nested("more fetching", [&]() {
             more_fetching(lengths, receive_length);
@@ -997,6 +1860,12 @@ class IO_Manager {
 
     bool exec() {
         ASSERT(tid == worker_id());
+        if (has_spilled && !sends_tasks()) {
+            // the first task did not fit into an empty epoch, so no
+            // follow-up epoch can take it either
+            printf("a task does not fit into an empty epoch\n");
+            return false;
+        }
         cpu_coverage_timer->end();
         time_nested(string("lock"), [&]() {
             dpu_control::dpu_mutex.lock();
@@ -1009,9 +1878,13 @@ class IO_Manager {
         working_manager = this;
 
         bool successful_send = false;
+        int64_t t0 = epoch_clock_ns();
         time_nested("send", [&]() {
             successful_send = send_task();
         });
+        int64_t t1 = epoch_clock_ns();
+        epoch_times.epochs++;
+        epoch_times.send += t1 - t0;
 
         bool ret = false;
         if (successful_send) {
@@ -1027,23 +1900,30 @@ class IO_Manager {
             });
             pim_coverage_timer->end();
             cpu_coverage_timer->start();
+            int64_t t2 = epoch_clock_ns();
 
             time_nested("receive", [&]() {
                 receive_task();
                 // always use these two together, sync receive is SYNCHRONOUS
                 ret = sync();
             });
+            epoch_times.dpu += t2 - t1;
+            epoch_times.receive += epoch_clock_ns() - t2;
             working_manager = nullptr;
         }
         working_manager = nullptr;
         time_nested(string("unlock"), [&]() {
             dpu_control::dpu_mutex.unlock();
         });
+        if (has_spilled) {
+            // exec_spilled first: the spilled tasks run even if this epoch
+            // had no replies
+            ret = exec_spilled() && ret;
+        }
         return ret;
     }
 };
 
-const int NUM_IO_MANAGERS = 5;
 IO_Manager** io_managers;
 
 inline void init_io_managers() {
@@ -1,5 +1,8 @@
 #pragma once
 #include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
 #include <parlay/primitives.h>
 #include "operation_def.hpp"
 #include "random_generator.hpp"
@@ -7,8 +10,6 @@ using namespace std;
 using namespace parlay;
 
 namespace skew_generator {
-double alpha = -1.0;
-sequence<double> zipf_pos;
 
 template <typename T>
 void print_array(string name, T* arr, int l) {
@@ -17,113 +18,121 @@ void print_array(string name, T* arr, int l) {
     }
 }
 
-void init_zipf_pos(int P) {
-    double sum = 0;
-    zipf_pos = sequence<double>(P, 1.0);
-    for (int i = 0; i < P; i++) {
-        zipf_pos[i] /= pow(i + 1, alpha);
-        sum += zipf_pos[i];
-    }
-    for (int i = 0; i < P; i++) {
-        zipf_pos[i] /= sum;
-        if (i > 0) {
-            zipf_pos[i] += zipf_pos[i - 1];
+// Vose's alias table for P(i) ~ 1 / (i + 1)^alpha over i < P. A sample is
+// a uniform slot plus a biased coin, both taken from one random word.
+class zipf_alias_table {
+   public:
+    int P;
+    sequence<double> prob;
+    sequence<int> alias;
+
+    zipf_alias_table(double alpha, int _P) : P(_P) {
+        auto w = parlay::tabulate(P, [&](size_t i) { return 1.0 / pow(i + 1, alpha); });
+        double sum = parlay::reduce(w);
+        prob = parlay::map(w, [&](double x) { return x / sum * P; });
+        alias = parlay::tabulate(P, [&](size_t i) { return (int)i; });
+        vector<int> small, large;
+        for (int i = 0; i < P; i++) {
+            (prob[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(), l = large.back();
+            small.pop_back();
+            alias[s] = l;
+            prob[l] -= 1.0 - prob[s];
+            if (prob[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
         }
+        // left overs are 1 up to rounding
+        for (int i : small) prob[i] = 1.0;
+        for (int i : large) prob[i] = 1.0;
     }
-}
 
-int biased_mapping(int64_t x, long siz, int bias, int l) {
-    return min(siz - 1, l + abs(x) % siz / bias + 1);
-}
+    int sample(uint64_t r) const {
+        int i = (int)(((r >> 32) * (uint64_t)P) >> 32);
+        double coin = (double)(r & 0xffffffffULL) * 0x1.0p-32;
+        return coin < prob[i] ? i : alias[i];
+    }
 
-void zipf_over_items(double a, slice<int*, int*> ids, int P, int ds_size) {
-    if (a != alpha) {
-        alpha = a;
-        init_zipf_pos(P);
+    // n samples, the i-th from the random word rand(i)
+    template <typename Rand>
+    sequence<int> sample_batch(size_t n, Rand rand) const {
+        return parlay::tabulate(n, [&](size_t i) { return sample(rand(i)); });
     }
+};
 
-    auto order = tabulate(P, [&](size_t i) { return i; });
-    for (int i = 0; i < P; i++) {
-        int r = abs(rn_gen::parallel_rand()) % (P - i);
-        swap(order[i], order[i + r]);
+// tables are built once per (alpha, P)
+const zipf_alias_table& zipf_table(double alpha, int P) {
+    static std::map<pair<double, int>, zipf_alias_table> tables;
+    static mutex tables_mutex;
+    unique_lock lock(tables_mutex);
+    auto key = make_pair(alpha, P);
+    auto it = tables.find(key);
+    if (it == tables.end()) {
+        it = tables.emplace(key, zipf_alias_table(alpha, P)).first;
     }
+    return it->second;
+}
 
-    auto slice_id = parlay::tabulate(ids.size(), [&](size_t i) {
-        double rd = (double)(abs(rn_gen::parallel_rand())) / (double)INT64_MAX;
-        int l = -1, r = P - 1;  // (]
-        while (r - l > 1) {
-            int mid = (l + r) >> 1;
-            if (zipf_pos[mid] < rd) {
-                l = mid;
-            } else {
-                r = mid;
-            }
-        }
-        int position = r;
-        return order[r];
+// a uniformly random order of 0 .. P - 1
+sequence<int> random_order(int P, uint64_t seed) {
+    auto tagged = parlay::tabulate(P, [&](size_t i) {
+        return make_pair(parlay::hash64(seed + i), (int)i);
     });
+    parlay::sort_inplace(tagged);
+    return parlay::map(tagged, [](const pair<uint64_t, int>& x) { return x.second; });
+}
+
+int biased_mapping(int64_t x, long siz, int bias, int l) {
+    return min(siz - 1, l + abs(x) % siz / bias + 1);
+}
+
+void zipf_over_items(double a, slice<int*, int*> ids, int P, int ds_size) {
+    auto& table = zipf_table(a, P);
+    auto pick = rn_gen::next_stream(), pos = rn_gen::next_stream();
+    auto order = random_order(P, rn_gen::next_stream()(0));
+    auto slice_id = table.sample_batch(ids.size(), pick);
 
     auto ls = tabulate(P, [&](size_t i) { return i * (ds_size / P); });
     parallel_for(0, ids.size(), [&](size_t i) {
-        int64_t x = rn_gen::parallel_rand();
-        ids[i] = biased_mapping(x, ds_size, P, ls[slice_id[i]]);
+        ids[i] = biased_mapping(pos(i), ds_size, P, ls[order[slice_id[i]]]);
     });
 }
 
 void all_or_nothing_items(int bias, slice<int*, int*> ids, int ds_size) {
-    int64_t l = (abs(rn_gen::parallel_rand()) % bias) * (ds_size / bias);
+    auto pos = rn_gen::next_stream();
+    int64_t l = (abs(rn_gen::next_stream()(0)) % bias) * (ds_size / bias);
     parallel_for(0, ids.size(), [&](size_t i) {
-        int64_t x = rn_gen::parallel_rand();
-        ids[i] = biased_mapping(x, ds_size, bias, l);
+        ids[i] = biased_mapping(pos(i), ds_size, bias, l);
     });
 }
 
 void zipf_over_keys(double a, slice<int64_t*, int64_t*> keys, int P) {
-    if (a != alpha) {
-        alpha = a;
-        init_zipf_pos(P);
-    }
-
-    auto order = tabulate(P, [&](size_t i) { return i; });
-    for (int i = 0; i < P; i++) {
-        int r = abs(rn_gen::parallel_rand()) % (P - i);
-        swap(order[i], order[i + r]);
-    }
-
-    auto slice_id = parlay::tabulate(keys.size(), [&](size_t i) {
-        double rd = (double)(abs(rn_gen::parallel_rand())) / (double)INT64_MAX;
-        int l = -1, r = P - 1;  // (]
-        while (r - l > 1) {
-            int mid = (l + r) >> 1;
-            if (zipf_pos[mid] < rd) {
-                l = mid;
-            } else {
-                r = mid;
-            }
-        }
-        int position = r;
-        return order[r];
-    });
+    auto& table = zipf_table(a, P);
+    auto pick = rn_gen::next_stream(), pos = rn_gen::next_stream();
+    auto order = random_order(P, rn_gen::next_stream()(0));
+    auto slice_id = table.sample_batch(keys.size(), pick);
 
     int64_t piece_size = (UINT64_MAX / P);
     auto ls = tabulate(P, [&](int64_t i) {
         return INT64_MIN + piece_size / 2 + piece_size * i;
     });
 
+    pos.fill(keys);
     parallel_for(0, keys.size(), [&](size_t i) {
-        int64_t x = rn_gen::parallel_rand() / P + ls[slice_id[i]];
-        keys[i] = x;
+        keys[i] = keys[i] / P + ls[order[slice_id[i]]];
     });
 }
 
 void all_or_nothing_keys(int bias, slice<int64_t*, int64_t*> ids) {
     uint64_t piece_size = (UINT64_MAX / bias);
-    int64_t piece_id = abs(rn_gen::parallel_rand()) % bias;
+    auto pos = rn_gen::next_stream();
+    int64_t piece_id = abs(rn_gen::next_stream()(0)) % bias;
     int64_t l = INT64_MIN + piece_size / 2 + piece_size * piece_id;
-    parallel_for(0, ids.size(), [&](size_t i) {
-        int64_t x = rn_gen::parallel_rand() / bias + l;
-        ids[i] = x;
-    });
+    pos.fill(ids);
+    parallel_for(0, ids.size(), [&](size_t i) { ids[i] = ids[i] / bias + l; });
 }
 
 }  // namespace skew_generator
@@ -176,10 +185,11 @@ class test_generator {
     }
     void fill_with_random_ops(slice<operation*, operation*> ops) {
         int n = ops.size();
+        auto rs = rn_gen::next_stream();
         parlay::parallel_for(0, n, [&](size_t i) {
-            int64_t k = rn_gen::parallel_rand();
-            int64_t v = rn_gen::parallel_rand();
-            double rd = (double(abs(rn_gen::parallel_rand()) % 16384)) / 16384;
+            int64_t k = rs(3 * i);
+            int64_t v = rs(3 * i + 1);
+            double rd = (double(abs(rs(3 * i + 2)) % 16384)) / 16384;
             int64_t in_key = 0;
             fill(ops[i], k, v, in_key, rd);
         });
@@ -226,11 +236,12 @@ class test_generator {
                 skew_generator::all_or_nothing_items(bias, make_slice(ids),
                                                      keys.size());
             }
+            auto values = rn_gen::next_stream();
             parlay::parallel_for(0, batch_size, [&](size_t i) {
                 operation op;
                 op.type = operation_t::update_t;
                 op.tsk.u.key = keys[ids[i]].key;
-                op.tsk.u.value = rn_gen::parallel_rand();
+                op.tsk.u.value = values(i);
                 sub_slice[i] = op;
             });
         }
@@ -274,11 +285,12 @@ class test_generator {
                 skew_generator::all_or_nothing_keys(bias, make_slice(ids));
             }
 
+            auto values = rn_gen::next_stream();
             parlay::parallel_for(0, batch_size, [&](size_t i) {
                 operation op;
                 op.type = operation_t::insert_t;
                 op.tsk.i.key = ids[i];
-                op.tsk.i.value = rn_gen::parallel_rand();
+                op.tsk.i.value = values(i);
                 sub_slice[i] = op;
             });
         }
@@ -353,7 +365,7 @@ class test_generator {
         }
         printf("single type=%d\n", single_type);
         if (single_type) { // micro benchmarks
-            double rd = (double)(abs(rn_gen::parallel_rand())) / (double)INT64_MAX;
+            double rd = (double)(abs(rn_gen::next_stream()(0))) / (double)INT64_MAX;
             for (int t = 0; t < OPERATION_NR_ITEMS; t++) {
                 if (rd < possibilities[t]) {
                 // if (possibilities[t] == 1.0) {
@@ -389,11 +401,11 @@ class test_generator {
             auto keys = parlay::delayed_seq<int64_t>(m, [&](size_t i) {
                 return kvs[i].key;
             });
+            auto rs = rn_gen::next_stream();
             parlay::parallel_for(0, n, [&](size_t i) {
-                int64_t k = rn_gen::parallel_rand() / bias;
-                int64_t v = rn_gen::parallel_rand();
-                double rd =
-                    (double(abs(rn_gen::parallel_rand()) % 16384)) / 16384;
+                int64_t k = rs(3 * i) / bias;
+                int64_t v = rs(3 * i + 1);
+                double rd = (double(abs(rs(3 * i + 2)) % 16384)) / 16384;
                 int64_t in_key = 0;
                 if (m > 0) {
                     in_key = abs(k) % m + 1;
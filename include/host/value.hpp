@@ -22,7 +22,7 @@ inline bool operator!=(const key_value& kv1, const key_value& kv2) {
     return !(kv1 == kv2);
 }
 
-ostream& operator<<(ostream& os, const key_value& kv) {
+std::ostream& operator<<(std::ostream& os, const key_value& kv) {
     os << "{Key=" << kv.key << ", Value=" << kv.value << "}";
     return os;
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <parlay/primitives.h>
+#include "debug.hpp"
+#include "op_file.hpp"
+#include "operation_def.hpp"
+#include "random_generator.hpp"
+
+using namespace std;
+using namespace parlay;
+
+// YCSB core workloads A - F. Records are numbered in insertion order: the
+// init keys first, then the keys inserted by the workload itself. A read is
+// a get, an update is an insert of an existing key, and a read-modify-write
+// is a get followed by an insert of the same key.
+namespace ycsb {
+
+enum distribution_t { uniform_d, zipfian_d, scrambled_d, latest_d, hotspot_d };
+const char* distribution_name[] = {"uniform", "zipfian", "scrambled", "latest",
+                                   "hotspot"};
+
+struct workload {
+    char name;
+    double read, update, insert, scan, rmw;
+    distribution_t dist;
+};
+
+inline bool is_core_workload(const string& s) {
+    return s.size() == 1 && s[0] >= 'a' && s[0] <= 'f';
+}
+
+inline bool is_distribution(const string& s) {
+    for (int d = uniform_d; d <= hotspot_d; d++) {
+        if (s == distribution_name[d]) return true;
+    }
+    return false;
+}
+
+// arguments are checked by is_core_workload / is_distribution first
+inline workload core_workload(char name) {
+    switch (name) {
+        case 'a': return {'a', 0.5, 0.5, 0.0, 0.0, 0.0, zipfian_d};
+        case 'b': return {'b', 0.95, 0.05, 0.0, 0.0, 0.0, zipfian_d};
+        case 'c': return {'c', 1.0, 0.0, 0.0, 0.0, 0.0, zipfian_d};
+        case 'd': return {'d', 0.95, 0.0, 0.05, 0.0, 0.0, latest_d};
+        case 'e': return {'e', 0.0, 0.0, 0.05, 0.95, 0.0, zipfian_d};
+        case 'f': return {'f', 0.5, 0.0, 0.0, 0.0, 0.5, zipfian_d};
+    }
+    ASSERT(false);  // not a core workload
+    return {};
+}
+
+inline distribution_t parse_distribution(const string& s) {
+    for (int d = uniform_d; d <= hotspot_d; d++) {
+        if (s == distribution_name[d]) return (distribution_t)d;
+    }
+    ASSERT(false);  // unknown distribution
+    return uniform_d;
+}
+
+struct config {
+    double theta = 0.99;        // zipfian constant
+    double hot_set = 0.2;       // hotspot: fraction of records that are hot
+    double hot_ops = 0.8;       // hotspot: fraction of operations on them
+    int max_scan_length = 100;  // scan length is uniform in [1, max]
+};
+
+// uniform in [0, 1)
+inline double unit(int64_t r) { return ((uint64_t)r >> 11) * 0x1.0p-53; }
+
+// zeta(n0 + j) = sum of 1 / i^theta over i <= n0 + j, for j <= extra
+inline sequence<double> zeta_range(int64_t n0, int64_t extra, double theta) {
+    double base = parlay::reduce(parlay::delayed_seq<double>(
+        n0, [&](size_t i) { return pow((double)(i + 1), -theta); }));
+    auto z = parlay::tabulate(extra + 1, [&](size_t j) {
+        return j == 0 ? base : pow((double)(n0 + j), -theta);
+    });
+    parlay::scan_inclusive_inplace(z);
+    return z;
+}
+
+// Gray et al., "Quickly generating billion-record synthetic databases": a
+// rank in [0, n) with P(rank) ~ 1 / (rank + 1)^theta, in O(1) given zeta(n)
+struct zipfian {
+    double theta, zeta2, alpha;
+
+    zipfian(double _theta)
+        : theta(_theta), zeta2(1 + pow(0.5, _theta)), alpha(1 / (1 - _theta)) {}
+
+    int64_t rank(int64_t n, double zetan, double u) const {
+        double uz = u * zetan;
+        if (uz < 1) return 0;
+        if (uz < zeta2) return min<int64_t>(1, n - 1);
+        double eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+        return min<int64_t>(n - 1, (int64_t)(n * pow(eta * u - eta + 1, alpha)));
+    }
+};
+
+// n operations of workload w over the records init_keys (in insertion
+// order). Operation i only reads records inserted before it, so the trace
+// is generated in one parallel pass after a scan over the insert positions.
+inline sequence<operation> generate(const workload& w,
+                                    slice<int64_t*, int64_t*> init_keys,
+                                    int64_t n, const config& conf = config()) {
+    enum { read_k, update_k, insert_k, scan_k, rmw_k };
+    int64_t n0 = init_keys.size();
+    ASSERT(n0 > 0);
+    ASSERT(conf.theta > 0 && conf.theta < 1);
+    ASSERT(fabs(w.read + w.update + w.insert + w.scan + w.rmw - 1.0) < 1e-9);
+
+    auto type_rs = rn_gen::next_stream(), pick_rs = rn_gen::next_stream();
+    auto aux_rs = rn_gen::next_stream(), key_rs = rn_gen::next_stream();
+    auto value_rs = rn_gen::next_stream();
+
+    auto kind = parlay::tabulate(n, [&](size_t i) -> int8_t {
+        double u = unit(type_rs(i)), acc = w.read;
+        if (u < acc) return read_k;
+        if (u < (acc += w.update)) return update_k;
+        if (u < (acc += w.insert)) return insert_k;
+        if (u < (acc += w.scan)) return scan_k;
+        return rmw_k;
+    });
+    auto [inserts_before, inserts] = parlay::scan(parlay::delayed_seq<int64_t>(
+        n, [&](size_t i) -> int64_t { return kind[i] == insert_k; }));
+    auto [offset, m] = parlay::scan(parlay::delayed_seq<int64_t>(
+        n, [&](size_t i) -> int64_t { return kind[i] == rmw_k ? 2 : 1; }));
+
+    sequence<double> zeta;
+    if (w.dist == zipfian_d || w.dist == scrambled_d || w.dist == latest_d) {
+        zeta = zeta_range(n0, inserts, conf.theta);
+    }
+    zipfian zipf(conf.theta);
+    auto key_of = [&](int64_t item) -> int64_t {
+        return item < n0 ? init_keys[item] : key_rs(item - n0);
+    };
+
+    auto ops = sequence<operation>(m);
+    parlay::parallel_for(0, n, [&](size_t i) {
+        int64_t records = n0 + inserts_before[i];
+        double u = unit(pick_rs(i));
+        int64_t item = 0;
+        switch (w.dist) {
+            case uniform_d: {
+                item = min<int64_t>(records - 1, (int64_t)(u * records));
+                break;
+            }
+            case zipfian_d: {
+                item = zipf.rank(records, zeta[records - n0], u);
+                break;
+            }
+            case scrambled_d: {
+                int64_t r = zipf.rank(records, zeta[records - n0], u);
+                item = parlay::hash64(r + 1) % records;
+                break;
+            }
+            case latest_d: {
+                item = records - 1 - zipf.rank(records, zeta[records - n0], u);
+                break;
+            }
+            case hotspot_d: {
+                int64_t hot = max<int64_t>(1, (int64_t)(records * conf.hot_set));
+                int64_t cold = records - hot;
+                double v = unit(aux_rs(2 * i));
+                if (u < conf.hot_ops || cold == 0) {
+                    item = min<int64_t>(hot - 1, (int64_t)(v * hot));
+                } else {
+                    item = hot + min<int64_t>(cold - 1, (int64_t)(v * cold));
+                }
+                break;
+            }
+        }
+        int64_t key = key_of(item), value = value_rs(i);
+        operation* out = &ops[offset[i]];
+        switch (kind[i]) {
+            case read_k: {
+                out[0] = make_op(operation_t::get_t, key, 0);
+                break;
+            }
+            case update_k: {
+                out[0] = make_op(operation_t::insert_t, key, value);
+                break;
+            }
+            case insert_k: {
+                out[0] = make_op(operation_t::insert_t, key_of(records), value);
+                break;
+            }
+            case scan_k: {
+                // records are spread evenly over the key space, so a scan of
+                // len records covers about len * 2^64 / records keys
+                int64_t len = 1 + (uint64_t)aux_rs(2 * i + 1) % conf.max_scan_length;
+                uint64_t span = records > len ? UINT64_MAX / records * len
+                                              : UINT64_MAX;
+                int64_t rkey = (span > (uint64_t)INT64_MAX - (uint64_t)key)
+                                   ? INT64_MAX
+                                   : (int64_t)((uint64_t)key + span);
+                out[0] = make_op(operation_t::scan_t, key, rkey);
+                break;
+            }
+            case rmw_k: {
+                out[0] = make_op(operation_t::get_t, key, 0);
+                out[1] = make_op(operation_t::insert_t, key, value);
+                break;
+            }
+        }
+    });
+    return ops;
+}
+
+};  // namespace ycsb